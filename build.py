@@ -1,6 +1,8 @@
 # Run with: python3 build.py
+# Or, for the CPU-only renderer that needs no SDL or OpenGL: python3 build.py headless
 import os
 import platform
+import sys
 
 # (1)==================== COMMON CONFIGURATION OPTIONS ======================= #
 COMPILER="g++ -std=c++17"   # The compiler we want to use 
@@ -31,6 +33,14 @@ elif platform.system()=="Windows":
     LIBRARIES="-lmingw32 -lSDL2main -lSDL2 -mwindows"
 # (2)=================== Platform specific configuration ===================== #
 
+# The headless target builds the CPU port of the shader with its own main() and no libraries
+if len(sys.argv) > 1 and sys.argv[1]=="headless":
+    SOURCE="./tools/headless.cpp ./src/CPUTracer.cpp ./src/SphereScene.cpp ./src/SphereBVH.cpp"
+    EXECUTABLE="headless.exe" if platform.system()=="Windows" else "headless"
+    INCLUDE_DIR="-I ./include/ -I ./common/thirdparty/glm/" # the glm bundled with this repository
+    ARGUMENTS+=" -O2 -pthread"
+    LIBRARIES=""
+
 # (3)====================== Building the Executable ========================== #
 # Build a string of our compile commands that we run in the terminal
 compileString=COMPILER+" "+ARGUMENTS+" -o "+EXECUTABLE+" "+" "+INCLUDE_DIR+" "+SOURCE+" "+LIBRARIES
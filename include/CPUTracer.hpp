@@ -0,0 +1,64 @@
+/** @file CPUTracer.hpp
+ *  @brief Renders the fragment shader's ray tracer on the CPU, without a window or GL context.
+ *
+ *  The port follows shaders/frag.glsl statement by statement in single precision: the same
+ *  rand12/rand22/rand32 hashes, materials, bounce limit and samples per pixel, tracing the
+ *  same SphereScene the real-time path uploads.
+ *  That makes it an oracle for regression tests of the shader and a fallback renderer on
+ *  machines without a GPU. Frames are split across threads by rows. Rays walk the same
+ *  SphereBVH as the shader, and each leaf's spheres are tested at once from structure-of-arrays
+ *  data the compiler vectorizes.
+ *
+ *  @bug Transcendental functions (sin, cos, acos, pow) come from the C library, whose results
+ *  can differ from a GPU's by an ulp or so, which may flip an occasional pixel.
+ */
+#ifndef CPU_TRACER_HPP
+#define CPU_TRACER_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "SphereScene.hpp"
+#include "SphereBVH.hpp"
+
+class CPUTracer {
+public:
+    // Constructor
+    // A thread count of 0 uses every hardware thread; the scene starts as SphereScene::defaultScene()
+    CPUTracer(int width, int height, int threads = 0);
+    // Replaces the spheres to trace
+    void setScene(const SphereScene& scene);
+    // Renders one frame for the given u_time, u_camSpin and u_frame uniforms
+    // Like the accumulation texture, the frame is blended into the previous ones unless frame is 0
+    void render(float time, float camSpin, int frame = 0);
+    // Returns the displayed color of a pixel before quantization; (0, 0) is the bottom-left corner, as in gl_FragCoord
+    glm::vec3 getPixel(int x, int y) const;
+    // Writes the frame as a binary PPM, quantized the way an 8-bit color buffer stores it
+    bool writePPM(const std::string& path) const;
+    // Returns the width of the frame
+    inline int getWidth() const {
+        return m_width;
+    };
+    // Returns the height of the frame
+    inline int getHeight() const {
+        return m_height;
+    };
+
+private:
+    // Renders rows of the frame until none are left
+    void renderRows(std::atomic<int>& nextRow, float time, float camSpin, int frame);
+    int m_width;
+    int m_height;
+    int m_threads;
+    // The scene and the hierarchy over it, the same one the shader walks
+    std::shared_ptr<SphereBVH> m_bvh;
+    // The sphere centers', in the hierarchy's order, x, y and z and the squared radii, as four consecutive arrays
+    std::vector<float> m_sphereArrays;
+    // The linear running average, as the shader's RGBA32F texture holds it
+    std::vector<glm::vec3> m_pixels;
+};
+
+#endif
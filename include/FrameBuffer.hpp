@@ -1,7 +1,15 @@
 /** @file FrameBuffer.hpp
- *  @brief Creates an offscreen texture to render to.
+ *  @brief Creates the offscreen textures the ray tracer accumulates into.
  *
  *  The 'create' function needs to be called before using the framebuffer.
+ *  Two RGBA32F textures take turns: each frame the trace shader reads the running average
+ *  from one (the history) and writes the average including its new samples into the other,
+ *  and a display shader shows the result. While the camera holds still the image converges;
+ *  when it moves, the frame counter resets and the history is ignored.
+ *  The shaders come from a ProgramCache when an earlier run linked them, and 'watchShaders'
+ *  rebuilds them whenever their files change.
+ *  With 'setRenderScale', frames are traced into a corner of the textures only, and the
+ *  display shader stretches that corner over the window with bilinear filtering.
  *
  *  @bug No known bugs.
  */
@@ -20,10 +28,26 @@
 #include "glm/mat4x4.hpp"
 #include "Shader.hpp"
 #include "Camera.hpp"
+#include "SphereScene.hpp"
+#include "SphereBVH.hpp"
+#include "UniformBuffer.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderReloader.hpp"
 
 // Each Framebuffer can have a custom shader, so we are forward declaring the class
 class Shader;
 
+// Mirrors the std140 FrameUniforms block in frag.glsl
+struct FrameUniforms {
+    glm::vec2 resolution; // offset 0
+    float time; // offset 8
+    float camSpin; // offset 12
+    int frame; // offset 16
+    int sphereCount; // offset 20
+    int padding[2]; // std140 rounds a block up to a multiple of 16 bytes
+};
+static_assert(sizeof(FrameUniforms) == 32, "FrameUniforms must match the std140 layout of the shader's block");
+
 class FrameBuffer {
 public:
     // Constructor
@@ -32,26 +56,74 @@ public:
     ~FrameBuffer();
     // Creates the framebuffer
     void create(int width, int height);
-    // Selects our framebuffer
+    // Traces the following frames into the lower left scale * scale of the textures
+    void setRenderScale(float scale);
+    // Returns the resolution the frames are traced at
+    inline int getRenderWidth() const {
+        return m_renderWidth;
+    };
+    inline int getRenderHeight() const {
+        return m_renderHeight;
+    };
+    // Uploads the spheres the shader traces, with a hierarchy built over them
+    bool setScene(const SphereScene& scene);
+    // Selects the framebuffer this frame accumulates into
     void bind() const;
     // Updates our framebuffer once per frame for any changes that may have occurred
-    void update(const glm::mat4& projectionMatrix, Camera* camera, int screenWidth, int screenHeight, float time) const;
+    void update(const glm::mat4& projectionMatrix, Camera* camera, float time);
     // Done with our framebuffer
     static void unbind();
+    // Traces this frame's samples and blends them with the history
+    void drawAccumulation() const;
     // Draws a quad to the screen
     void drawFBO() const;
+    // Makes this frame's average the history of the next one
+    void swap();
+    // Rebuilds the shaders in the background whenever their files change
+    void watchShaders(SDL_Window* window);
+    // Returns how many frames the current average holds
+    inline int getAccumulatedFrames() const {
+        return m_frame + 1;
+    };
     std::shared_ptr<Shader> m_shader;
+    // Turns the accumulated average into displayable colors
+    std::shared_ptr<Shader> m_displayShader;
 
 private:
     // Creates a quad that will be overlaid on top of the screen
     void setupScreenQuad(float x, float y, float w, float h);
-    // Framebuffer id
-    GLuint m_fboID;
+    // Sets the texture units of the samplers and connects the uniform block
+    void setupShaderState();
+    // Fills one of the scene's texture buffers with RGBA32F texels
+    void uploadTextureBuffer(int index, const std::vector<float>& texels);
+    // The size of the textures, which is the window's, and the part of them the frames are traced into
+    int m_width;
+    int m_height;
+    int m_renderWidth;
+    int m_renderHeight;
+    // Where the display shader finds the traced part of the texture
+    Uniform<glm::vec2> m_renderSizeUniform;
+    // Framebuffer ids, one per accumulation texture
+    GLuint m_fboIDs[2];
     // Store our screen buffer
     GLuint m_quadVAO;
     GLuint m_quadVBO;
-    // Our framebuffer also needs a texture
-    GLuint m_colorBufferID;
+    // The accumulation textures; m_current is written this frame, the other one holds the history
+    GLuint m_accumulationIDs[2];
+    int m_current;
+    // Frames blended into the history since the last reset; 0 means there is no history
+    int m_frame;
+    // The texture buffers of the spheres and of their hierarchy, and the textures the shader samples them through
+    GLuint m_sceneBufferIDs[2];
+    GLuint m_sceneTextureIDs[2];
+    int m_sphereCount;
+    // The per-frame uniforms of the trace shader
+    std::unique_ptr<UniformBuffer> m_frameUniforms;
+    // Linked programs kept on disk, and the watcher that rebuilds changed shaders if there is one
+    std::shared_ptr<ProgramCache> m_programCache;
+    std::unique_ptr<ShaderReloader> m_reloader;
+    // The u_time * u_camSpin product the shader places its camera with, to notice motion
+    float m_cameraAngle;
     glm::mat4 m_worldTransform;
 };
 
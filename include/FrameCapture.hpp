@@ -0,0 +1,88 @@
+/** @file FrameCapture.hpp
+ *  @brief Records the frames the window shows, without stalling the renderer.
+ *
+ *  Every frame is copied from the back buffer into one of a ring of pixel buffer objects,
+ *  and a fence marks when the copy is done; the CPU only maps a buffer once its fence has
+ *  signaled, a frame or two later. Mapped frames go through a lock-free queue to a writer
+ *  thread, which encodes them as raw RGB24, a Y4M video or a sequence of PNG images.
+ *  When the readbacks or the writer fall behind, frames are dropped rather than waited
+ *  for, and counted; the counts are printed when the capture ends.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include "SPSCQueue.hpp"
+
+// The files a capture writes
+enum CaptureFormat {
+    CAPTURE_RAW, // path.rgb, rows of RGB24 from the top, for ffmpeg -f rawvideo -pix_fmt rgb24
+    CAPTURE_Y4M, // path.y4m, full range 4:4:4 YCbCr
+    CAPTURE_PNG  // path_000000.png and so on, one uncompressed image per frame
+};
+
+class FrameCapture {
+public:
+    // Constructor
+    // Captures a width * height window whose frames are shown fps times per second
+    FrameCapture(int width, int height, double fps, CaptureFormat format, const std::string& path);
+    // Destructor
+    // Waits for the frames in flight and the writer, then prints how many frames were captured and dropped
+    ~FrameCapture();
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+    // Reads the back buffer back; call it after a frame has been drawn and before the window swaps
+    void capture();
+    // Reads "raw", "y4m" or "png"; returns false for anything else
+    static bool parseFormat(const std::string& name, CaptureFormat& format);
+
+private:
+    // A frame on its way to the writer: RGBA rows from the bottom, as glReadPixels returns them
+    struct CapturedFrame {
+        std::vector<unsigned char> pixels;
+        long long index;
+    };
+    // Hands the finished readbacks to the writer, oldest first; with wait, waits for all of them
+    void collect(bool wait);
+    // Writes frames until the capture ends
+    void run();
+    // Writes one frame in the capture's format
+    void write(const CapturedFrame& frame);
+    // Readbacks in flight
+    static const int PBO_COUNT = 3;
+    // Frames that can wait for the writer
+    static const int QUEUED_FRAMES = 8;
+    int m_width;
+    int m_height;
+    CaptureFormat m_format;
+    std::string m_path;
+    GLuint m_pbos[PBO_COUNT];
+    GLsync m_fences[PBO_COUNT];
+    int m_oldest;
+    int m_inFlight;
+    // Frames travel to the writer through m_full, and their buffers come back through m_free
+    SPSCQueue<CapturedFrame> m_full;
+    SPSCQueue<CapturedFrame> m_free;
+    std::ofstream m_stream;
+    std::thread m_writer;
+    std::atomic<bool> m_done;
+    // Frames read back, and frames dropped because a readback or the writer was behind
+    long long m_captured;
+    long long m_dropped;
+    // Frames the writer could not write
+    std::atomic<long long> m_failed;
+    // The writer's own buffers, sized in the constructor so writing a frame allocates nothing:
+    // the converted rows or planes, and for PNG the encoded image and its file name
+    std::vector<unsigned char> m_scratch;
+    std::vector<unsigned char> m_encoded;
+    std::string m_fileName;
+};
+
+#endif
@@ -0,0 +1,40 @@
+/** @file FramePacer.hpp
+ *  @brief Paces frames to a target rate and records how long each one took.
+ *
+ *  Deadlines advance by exactly one period per frame, so the rate does not drift with the
+ *  time spent between frames. The pacer sleeps until shortly before a deadline and spins on
+ *  std::chrono::steady_clock for the rest, since sleeps are only good to about a millisecond.
+ *  A frame that misses its deadline by more than a period starts the schedule over instead
+ *  of rushing the following frames to catch up.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+class FramePacer {
+public:
+    typedef std::chrono::steady_clock Clock;
+    // Constructor
+    // A target of 0 frames per second records frame times without waiting, for when vsync paces
+    explicit FramePacer(double targetFps);
+    // Waits for the next frame's deadline, then records the time since the previous frame
+    void endFrame();
+    // Returns the p-th percentile (0 to 100) of the recorded frame times in milliseconds
+    double percentile(double p) const;
+    // Prints the number of frames and the mean, p50, p99 and worst frame times
+    void report(std::ostream& out) const;
+
+private:
+    Clock::duration m_period;
+    Clock::time_point m_deadline;
+    Clock::time_point m_lastFrame;
+    // Milliseconds between consecutive frames
+    std::vector<double> m_frameTimes;
+};
+
+#endif
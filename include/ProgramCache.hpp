@@ -0,0 +1,61 @@
+/** @file ProgramCache.hpp
+ *  @brief Keeps linked shader programs on disk, so later runs skip compiling and linking.
+ *
+ *  A program is stored with glGetProgramBinary under a key hashed from its sources and the
+ *  driver's vendor, renderer and version strings; a new driver or an edited shader misses
+ *  the cache and is compiled as usual. The binaries come from ARB_get_program_binary, which
+ *  our OpenGL 3.3 glad does not load, so the cache loads its three entry points itself and
+ *  turns itself off where the driver offers no binary formats.
+ *  'load' and 'store' may run on any thread with a context current that shares with the
+ *  one the cache was created on.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // this works for Mac
+    #include <SDL.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <glad/glad.h>
+
+class ProgramCache {
+public:
+    // Constructor
+    // Needs a current context; binaries go into the directory, which is created if needed
+    explicit ProgramCache(const std::string& directory = "./shadercache");
+    // Whether the driver can hand out program binaries at all
+    inline bool isSupported() const {
+        return m_supported;
+    };
+    // Returns a linked program for the sources from the cache, or 0 on a miss
+    GLuint load(const std::string& vertexSource, const std::string& fragmentSource) const;
+    // Asks the driver to keep the binary of a program that is about to be linked
+    void prepare(GLuint program) const;
+    // Saves a linked program's binary for the sources
+    void store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource) const;
+
+private:
+    // The entry points of ARB_get_program_binary
+    typedef void (APIENTRYP GetProgramBinaryFunction)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRYP ProgramBinaryFunction)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriFunction)(GLuint program, GLenum pname, GLint value);
+    // Returns the file a program of the sources is kept in
+    std::string pathFor(const std::string& vertexSource, const std::string& fragmentSource) const;
+    // Hashes bytes with 64-bit FNV-1a, continuing from a previous hash
+    static std::uint64_t hash(const std::string& bytes, std::uint64_t seed);
+    std::string m_directory;
+    // Vendor, renderer and version, which a binary is only valid for
+    std::string m_driver;
+    bool m_supported;
+    GetProgramBinaryFunction m_getProgramBinary;
+    ProgramBinaryFunction m_programBinary;
+    ProgramParameteriFunction m_programParameteri;
+};
+
+#endif
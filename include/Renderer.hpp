@@ -16,6 +16,7 @@
 #include "Shader.hpp"
 #include "Camera.hpp"
 #include "FrameBuffer.hpp"
+#include "ResolutionScaler.hpp"
 
 
 class Renderer {
@@ -26,6 +27,12 @@ public:
     ~Renderer();
     // Renders the scene
     void render(float time);
+    // Replaces the spheres the ray tracer renders
+    bool setScene(const SphereScene& scene);
+    // Lowers the resolution of the ray tracer whenever it takes longer than targetMs on the GPU; 0 keeps the full resolution
+    void setTargetFrameTime(float targetMs);
+    // Rebuilds the shaders whenever their files change
+    void watchShaders(SDL_Window* window);
     // Returns the camera
     inline Camera* getCamera() {
         return m_camera;
@@ -36,6 +43,8 @@ private:
     // Store the projection matrix for our camera
     glm::mat4 m_projectionMatrix;
     FrameBuffer* m_frameBuffer;
+    // Picks the resolution the frames are traced at
+    ResolutionScaler* m_resolutionScaler;
     // Screen dimensions constants
     int m_screenWidth;
     int m_screenHeight;
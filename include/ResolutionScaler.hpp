@@ -0,0 +1,62 @@
+/** @file ResolutionScaler.hpp
+ *  @brief Picks the resolution of the trace pass so it holds a target frame time.
+ *
+ *  The trace pass is timed on the GPU with GL_TIME_ELAPSED queries, read back a few frames
+ *  late so the CPU never waits for one. Its cost grows with the number of pixels, so a
+ *  pass that is over budget has each side of the image scaled by sqrt(target / time).
+ *  A new scale throws the accumulated frames away, so the scale moves in steps of
+ *  1 / SCALE_STEPS, drops as soon as the smoothed time is over budget, and only rises
+ *  after a run of frames with room to spare.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef RESOLUTION_SCALER_HPP
+#define RESOLUTION_SCALER_HPP
+
+#include <glad/glad.h>
+
+// Scales are multiples of 1 / SCALE_STEPS, no smaller than MIN_RENDER_SCALE
+const int SCALE_STEPS = 20;
+const float MIN_RENDER_SCALE = 0.25f;
+// The number of consecutive frames with room to spare before the scale rises
+const int RAISE_AFTER_FRAMES = 60;
+
+class ResolutionScaler {
+public:
+    // Constructor
+    // A target of 0 milliseconds keeps the full resolution
+    explicit ResolutionScaler(float targetMs);
+    // Destructor
+    ~ResolutionScaler();
+    ResolutionScaler(const ResolutionScaler&) = delete;
+    ResolutionScaler& operator=(const ResolutionScaler&) = delete;
+    // Starts timing the trace pass
+    void begin();
+    // Stops timing the trace pass, and reads the timings that are ready to adjust the scale
+    void end();
+    // Returns the fraction of the window's width and height the trace pass should draw
+    inline float getScale() const {
+        return m_scale;
+    };
+
+private:
+    // Adjusts the scale to a new trace pass timing
+    void adjust(float milliseconds);
+    // Timings in flight; while all of them wait on the GPU, frames go untimed
+    static const int QUERY_COUNT = 4;
+    GLuint m_queries[QUERY_COUNT];
+    // The scale each query's frame was drawn at, so timings of an old scale are ignored
+    float m_queryScales[QUERY_COUNT];
+    bool m_pending[QUERY_COUNT];
+    // The query that times the next frame, and whether one is timing the current frame
+    int m_next;
+    bool m_timing;
+    float m_targetMs;
+    float m_scale;
+    // An exponential moving average of the timings at the current scale; below 0 there are none yet
+    float m_smoothedMs;
+    // Consecutive timings with enough room for a larger scale
+    int m_framesUnderBudget;
+};
+
+#endif
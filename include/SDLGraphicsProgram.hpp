@@ -25,8 +25,34 @@
 #include <fstream>
 #include <functional>
 #include <chrono>
+#include <algorithm>
+#include <vector>
 // Project libraries
 #include "Renderer.hpp"
+#include "FramePacer.hpp"
+#include "FrameCapture.hpp"
+
+// How the interactive loop runs
+struct LoopOptions {
+    // Rebuild the shaders when their files change
+    bool watchShaders = false;
+    // Let the display pace the frames, with adaptive vsync where the driver has it
+    bool vsync = true;
+    // The frame rate to pace to without vsync; 0 draws as fast as possible
+    double targetFps = 55.0;
+    // The GPU time in milliseconds the ray tracer may take per frame before its resolution drops; 0 keeps the full resolution
+    float targetFrameMs = 15.0f;
+    // A scene file to render instead of the default scene; empty keeps the default
+    std::string scenePath;
+    // Where to record the frames the window shows, without an extension; empty records nothing
+    std::string capturePath;
+    CaptureFormat captureFormat = CAPTURE_Y4M;
+};
+
+// The seconds of simulated time per input and camera update
+const double SIMULATION_STEP = 1.0 / 120.0;
+// At most this many seconds are simulated between two frames
+const double MAX_SIMULATION_BACKLOG = 0.25;
 
 class SDLGraphicsProgram {
 public:
@@ -35,7 +61,10 @@ public:
     // Destructor
     ~SDLGraphicsProgram();
     // Loops forever
-    void loop();
+    // Input moves the camera in fixed steps of SIMULATION_STEP seconds, however fast frames are drawn
+    void loop(const LoopOptions& options);
+    // Times frames of random scenes with each of the given sphere counts and prints the results
+    void benchmark(const std::vector<int>& sphereCounts, int frames);
     // Gets pointer to window
     inline SDL_Window* getSDLWindow() {
         return m_window;
@@ -0,0 +1,57 @@
+/** @file SPSCQueue.hpp
+ *  @brief A bounded queue for one producer thread and one consumer thread, without locks.
+ *
+ *  The slots are allocated once, so passing values through never allocates; values are
+ *  moved in and out. Each index is written by one thread only and published with release
+ *  and acquire ordering, which is all two threads need to agree on a ring buffer.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class SPSCQueue {
+public:
+    // Constructor
+    // Holds up to capacity values
+    explicit SPSCQueue(size_t capacity) : m_slots(capacity), m_head(0), m_tail(0) {}
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+    // Adds a value; only the producer may call this
+    // Returns false, leaving the value as it was, if the queue is full
+    bool tryPush(T&& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+            return false;
+        }
+        m_slots[tail % m_slots.size()] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    // Takes the oldest value; only the consumer may call this
+    // Returns false if the queue is empty
+    bool tryPop(T& value) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_slots[head % m_slots.size()]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_slots;
+    // Both only grow; the consumer advances the head and the producer the tail
+    // They sit on separate cache lines, so the two threads do not keep taking the line from each other
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+};
+
+#endif
@@ -2,6 +2,11 @@
  *  @brief Manages the loading, compiling, and linking of vertex and fragment shaders.
  *  
  *  Additionally, it has functions for setting various uniforms.
+ *  After linking, every active uniform and uniform block is looked up once and kept in a
+ *  hash map. Uniforms set every frame should go through a typed Uniform handle, which holds
+ *  the location and needs no lookup at all, or through a uniform block and a UniformBuffer.
+ *  Programs can be loaded from a ProgramCache, and 'buildProgram' and 'adoptProgram' let a
+ *  ShaderReloader link a new version on another thread and swap it in between frames.
  *
  *  @bug No known bugs.
  */
@@ -16,9 +21,35 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <chrono>
 #include <string>
+#include <unordered_map>
 #include <glad/glad.h>
+#include "glm/vec2.hpp"
+#include "glm/mat4x4.hpp"
+#include "ProgramCache.hpp"
+
+// A uniform's location, resolved once; setting it costs no lookup
+// The shader it came from needs to be bound while setting it
+template <typename T>
+class Uniform {
+public:
+    // Constructor
+    // A location of -1 makes a handle whose 'set' does nothing, like glUniform does
+    explicit Uniform(GLint location = -1) : m_location(location) {}
+    // Sets the value
+    void set(const T& value) const;
+    // Whether the handle refers to an active uniform
+    inline bool isValid() const {
+        return m_location >= 0;
+    };
+    // Whether a uniform of this GLSL type can be set through this handle
+    static bool accepts(GLenum type);
+
+private:
+    GLint m_location;
+};
 
 class Shader {
 public:
@@ -33,11 +64,37 @@ public:
     // Loads a shader
     static std::string loadShader(const std::string &fileName);
     // Creates a shader from a loaded vertex and fragment shaders
-    void createShader(const std::string &vertexShaderSource, const std::string &fragmentShaderSource);
+    // With a cache, a program linked by an earlier run is loaded instead of being compiled
+    void createShader(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const ProgramCache* cache = nullptr);
+    // Compiles and links a program, or loads it from the cache; returns 0 if it does not link
+    // Touches no Shader, so it can run on a background thread with a shared context current
+    static GLuint buildProgram(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const ProgramCache* cache = nullptr);
+    // Replaces the program with one linked elsewhere, deleting the old one
+    // Uniform handles and uniform block bindings of the old program have to be set up again
+    void adoptProgram(GLuint program);
     // Returns the shader ID
     inline GLuint getID() const {
         return m_shaderID;
     }
+    // Returns a typed handle to an active uniform
+    // A missing uniform, or one whose type does not match T, gives an invalid handle and a log message
+    template <typename T>
+    Uniform<T> getUniform(const std::string& name) const {
+        auto found = m_uniforms.find(name);
+        if (found == m_uniforms.end()) {
+            log("getUniform", ("no active uniform " + name + ", maybe a misspelling or optimized out?").c_str());
+            return Uniform<T>();
+        }
+        if (!Uniform<T>::accepts(found->second.type)) {
+            log("getUniform", ("the type of " + name + " does not match the handle").c_str());
+            return Uniform<T>();
+        }
+        return Uniform<T>(found->second.location);
+    }
+    // Connects the named uniform block to a binding point a UniformBuffer is bound to
+    bool bindUniformBlock(const std::string& name, GLuint bindingPoint) const;
+    // Returns the size in bytes the driver reserves for the named uniform block, or 0 if there is none
+    GLint getUniformBlockSize(const std::string& name) const;
     // Sets the uniforms for a shader
     void setUniformMatrix4fv(const GLchar* name, const GLfloat* value) const;
 	void setUniform2fv(const GLchar* name, const GLfloat* value) const;
@@ -45,6 +102,16 @@ public:
     void setUniform1f(const GLchar* name, float value) const;
 
 private:
+    // What reflection found out about an active uniform
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+    // Records the active uniforms and uniform blocks of the linked program
+    void reflect();
+    // Returns the location of an active uniform, or -1
+    GLint findUniform(const GLchar* name) const;
     // Compiles loaded shaders
     static unsigned int compileShader(unsigned int type, const std::string& source);
     // Checks if shaders 'linked' successfully
@@ -53,6 +120,20 @@ private:
     static void log(const char* system, const char* message);
     // The unique shaderID
     GLuint m_shaderID;
+    // The active uniforms by name; array uniforms are found by their name with and without "[0]"
+    std::unordered_map<std::string, UniformInfo> m_uniforms;
+    // The active uniform blocks' indices by name
+    std::unordered_map<std::string, GLuint> m_uniformBlocks;
 };
 
+// The handle types the shaders use; each one sets its value with the matching glUniform call
+template <> void Uniform<int>::set(const int& value) const;
+template <> void Uniform<float>::set(const float& value) const;
+template <> void Uniform<glm::vec2>::set(const glm::vec2& value) const;
+template <> void Uniform<glm::mat4>::set(const glm::mat4& value) const;
+template <> bool Uniform<int>::accepts(GLenum type);
+template <> bool Uniform<float>::accepts(GLenum type);
+template <> bool Uniform<glm::vec2>::accepts(GLenum type);
+template <> bool Uniform<glm::mat4>::accepts(GLenum type);
+
 #endif
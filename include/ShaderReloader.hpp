@@ -0,0 +1,85 @@
+/** @file ShaderReloader.hpp
+ *  @brief Rebuilds shaders whose files change while the program runs.
+ *
+ *  A background thread polls the files' modification times. When one changes, it compiles
+ *  and links the new sources on a second OpenGL context that shares objects with the main
+ *  one, so the frames keep coming while the driver works, and fences the result.
+ *  'poll', called once per frame on the main thread, swaps in every program whose fence has
+ *  signaled and never waits for one that has not. A program that fails to build is logged
+ *  and the old one stays in use.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef SHADER_RELOADER_HPP
+#define SHADER_RELOADER_HPP
+
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // this works for Mac
+    #include <SDL.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include "Shader.hpp"
+#include "ProgramCache.hpp"
+
+class ShaderReloader {
+public:
+    // Constructor
+    // Creates the background context; the main context has to be current on this thread
+    ShaderReloader(SDL_Window* window, std::shared_ptr<ProgramCache> cache);
+    // Destructor
+    // Stops the thread and drops programs that were never swapped in
+    ~ShaderReloader();
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+    // Whether the background context could be created; without it nothing is reloaded
+    inline bool isRunning() const {
+        return m_thread.joinable();
+    };
+    // Rebuilds the shader whenever one of its files changes
+    void watch(std::shared_ptr<Shader> shader, const std::string& vertexPath, const std::string& fragmentPath);
+    // Swaps in the programs that finished building; returns whether any shader changed
+    // The caller has to set the uniforms and block bindings of the changed shaders up again
+    bool poll();
+
+private:
+    // A shader and the files it is built from
+    struct Watched {
+        std::shared_ptr<Shader> shader;
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::filesystem::file_time_type vertexTime;
+        std::filesystem::file_time_type fragmentTime;
+    };
+    // A program built on the background context, waiting for its fence
+    struct Built {
+        std::shared_ptr<Shader> shader;
+        GLuint program;
+        GLsync fence;
+    };
+    // Polls the files and rebuilds what changed, until the reloader is destroyed
+    void run();
+    // Returns the file's modification time, or the oldest time if it cannot be read
+    static std::filesystem::file_time_type modificationTime(const std::string& path);
+    SDL_Window* m_window;
+    SDL_GLContext m_context;
+    std::shared_ptr<ProgramCache> m_cache;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+    // Guards m_watched, m_built and the wake-ups of the thread
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<Watched> m_watched;
+    std::vector<Built> m_built;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/** @file SphereBVH.hpp
+ *  @brief Builds a bounding volume hierarchy over a SphereScene, flattened for the shader.
+ *
+ *  Nodes are stored depth first, so an interior node's first child directly follows it.
+ *  Every node packs into BVH_TEXELS RGBA32F texels:
+ *  (boundsMin.xyz, second child or first sphere), (boundsMax.xyz, sphere count or -(split axis + 1)).
+ *  Leaves index the spheres of getScene(), which holds the input spheres reordered so every leaf's
+ *  spheres are contiguous. Indices travel as floats, which is exact below 2^24.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef SPHERE_BVH_HPP
+#define SPHERE_BVH_HPP
+
+#include <vector>
+#include "glm/vec3.hpp"
+#include "SphereScene.hpp"
+
+// Texels per node in the packed layout
+const int BVH_TEXELS = 2;
+// The tree is never deeper than this, so a traversal stack of this many entries cannot overflow
+// It matches BVH_STACK_SIZE in frag.glsl
+const int BVH_MAX_DEPTH = 32;
+// Indices travel as floats, so every node and sphere index must stay below this to survive the trip
+const int BVH_MAX_INDEX = 1 << 24;
+
+struct BVHNode {
+    glm::vec3 boundsMin;
+    // Interior nodes: the index of the second child; leaves: the index of the first sphere
+    int secondChildOrFirstSphere;
+    glm::vec3 boundsMax;
+    // Leaves: the number of spheres; interior nodes: -(split axis + 1), so the traversal can visit the nearer child first
+    int countOrAxis;
+};
+
+class SphereBVH {
+public:
+    // Constructor
+    // Builds the hierarchy with the surface area heuristic over binned sphere centers
+    explicit SphereBVH(const SphereScene& scene);
+    // Returns the nodes, root first
+    inline const std::vector<BVHNode>& getNodes() const {
+        return m_nodes;
+    };
+    // Returns the spheres in the order the leaves index them
+    inline const SphereScene& getScene() const {
+        return m_scene;
+    };
+    // Returns the number of levels below the root
+    inline int getDepth() const {
+        return m_depth;
+    };
+    // Packs the nodes into 4 * BVH_TEXELS floats each, ready for a GL_RGBA32F texture buffer
+    std::vector<float> pack() const;
+
+private:
+    // Appends the node for spheres [first, first + count) of m_order, then its subtree
+    void build(const std::vector<Sphere>& spheres, int first, int count, int depth);
+    // Input sphere indices, partitioned as the build goes
+    std::vector<int> m_order;
+    std::vector<BVHNode> m_nodes;
+    SphereScene m_scene;
+    int m_depth;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/** @file SphereScene.hpp
+ *  @brief Holds the spheres the ray tracer renders, independently of OpenGL.
+ *
+ *  The real-time path uploads a scene into a texture buffer the fragment shader loops over,
+ *  so the sphere count is a runtime value; the CPU port reads the same scene directly.
+ *  Every sphere packs into SPHERE_TEXELS RGBA32F texels:
+ *  (center.xyz, radius), (albedo.rgb, material type), (metal fuzz, index of refraction, 0, 0).
+ *  Scenes can also come from the scene files the CPU tracer in oneWeekend reads, see scene_file.h.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef SPHERE_SCENE_HPP
+#define SPHERE_SCENE_HPP
+
+#include <string>
+#include <vector>
+#include "glm/vec3.hpp"
+
+// The material types, with the values frag.glsl compares against
+const int MATERIAL_LAMBERTIAN = 0;
+const int MATERIAL_METAL = 1;
+const int MATERIAL_DIELECTRIC = 2;
+
+// Texels per sphere in the packed layout
+const int SPHERE_TEXELS = 3;
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+    int materialType;
+    glm::vec3 albedo;
+    float metalFuzz;
+    float indexOfRefraction;
+};
+
+class SphereScene {
+public:
+    // Adds a sphere to the scene
+    void add(const Sphere& sphere);
+    // Returns the spheres
+    inline const std::vector<Sphere>& getSpheres() const {
+        return m_spheres;
+    };
+    // Returns the number of spheres
+    inline int getSphereCount() const {
+        return static_cast<int>(m_spheres.size());
+    };
+    // Packs the spheres into 4 * SPHERE_TEXELS floats each, ready for a GL_RGBA32F texture buffer
+    std::vector<float> pack() const;
+    // Returns the scene frag.glsl used to hard-code: a ground, three large spheres and 20 small ones
+    static SphereScene defaultScene();
+    // Returns the default scene's ground and large spheres plus small random ones, count spheres in all
+    // The same count and seed always give the same scene
+    static SphereScene randomScene(int count, unsigned int seed = 1);
+    // Reads a text or binary scene file, as written for the CPU tracer
+    // Returns false, and prints why, if the file cannot be read
+    static bool fromFile(const std::string& path, SphereScene& scene);
+
+private:
+    std::vector<Sphere> m_spheres;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/** @file UniformBuffer.hpp
+ *  @brief Holds the data of a uniform block, so a whole block is uploaded in one call.
+ *
+ *  The C++ struct mirroring a block has to follow the std140 layout rules of the block's
+ *  declaration; keep a static_assert on its size next to it. Bind the buffer to a binding
+ *  point and connect the block to the same point with 'Shader::bindUniformBlock'.
+ *
+ *  @bug No known bugs.
+ */
+#ifndef UNIFORM_BUFFER_HPP
+#define UNIFORM_BUFFER_HPP
+
+#include <cstddef>
+#include <glad/glad.h>
+
+class UniformBuffer {
+public:
+    // Constructor
+    // Allocates size bytes and binds them to the binding point
+    UniformBuffer(size_t size, GLuint bindingPoint);
+    // Destructor
+    ~UniformBuffer();
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    // Replaces the first size bytes of the buffer in a single upload
+    void update(const void* data, size_t size) const;
+    // Replaces the whole block from its mirroring struct
+    template <typename Block>
+    void update(const Block& block) const {
+        update(&block, sizeof(Block));
+    }
+    // Returns the binding point the buffer is bound to
+    inline GLuint getBindingPoint() const {
+        return m_bindingPoint;
+    };
+
+private:
+    GLuint m_bufferID;
+    GLuint m_bindingPoint;
+    size_t m_size;
+};
+
+#endif
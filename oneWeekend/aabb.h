@@ -0,0 +1,68 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+
+#include <utility>
+
+class aabb{
+	public:
+		interval x, y, z;
+
+		aabb() {}
+
+		aabb(const interval& ix, const interval& iy, const interval& iz) : x(ix), y(iy), z(iz) {}
+
+		aabb(const point3& a, const point3& b)
+			: x(fmin(a[0],b[0]), fmax(a[0],b[0])),
+			  y(fmin(a[1],b[1]), fmax(a[1],b[1])),
+			  z(fmin(a[2],b[2]), fmax(a[2],b[2])) {}
+
+		aabb(const aabb& box0, const aabb& box1) : x(box0.x, box1.x), y(box0.y, box1.y), z(box0.z, box1.z) {}
+
+		const interval& axis(int n) const{
+			if(n == 1) return y;
+			if(n == 2) return z;
+			return x;
+		}
+
+		bool empty() const{
+			return x.min > x.max || y.min > y.max || z.min > z.max;
+		}
+
+		point3 centroid() const{
+			return point3(0.5*(x.min + x.max), 0.5*(y.min + y.max), 0.5*(z.min + z.max));
+		}
+
+		real surface_area() const{
+			if(empty()) return 0;
+			return 2 * (x.size()*y.size() + y.size()*z.size() + z.size()*x.size());
+		}
+
+		int longest_axis() const{
+			if(x.size() > y.size())
+				return x.size() > z.size() ? 0 : 2;
+			return y.size() > z.size() ? 1 : 2;
+		}
+
+		// Slab test: clip the ray interval against the three pairs of axis-aligned planes.
+		bool hit(const ray& r, interval ray_t) const{
+			const point3& orig = r.origin();
+			const vec3& inv = r.inverse_direction();
+			for(int a = 0; a < 3; a++){
+				const interval& slab = axis(a);
+				auto t0 = (slab.min - orig[a]) * inv[a];
+				auto t1 = (slab.max - orig[a]) * inv[a];
+				if(inv[a] < 0)
+					std::swap(t0, t1);
+
+				if(t0 > ray_t.min) ray_t.min = t0;
+				if(t1 < ray_t.max) ray_t.max = t1;
+				if(ray_t.max <= ray_t.min)
+					return false;
+			}
+			return true;
+		}
+};
+
+#endif
@@ -0,0 +1,823 @@
+// Benchmarks for the CPU tracer.
+// Build: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// Run:   ./bench [name...]   (runs every benchmark when no name is given; exits with
+//        status 1 when a benchmark's correctness check fails)
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "camera.h"
+#include "image_writer.h"
+#include "linear_bvh.h"
+#include "scenes.h"
+#include "sphere_soa.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+using bench_clock = std::chrono::steady_clock;
+
+// Counts every heap allocation the program makes, for bench_allocations. The scalar and
+// array forms, plain and sized, are all replaced so every new is paired with a delete
+// of the same family. The deletes are kept out of line: inlined into a caller, GCC sees
+// free() on the result of operator new and reports a mismatch (-Wmismatched-new-delete).
+static std::atomic<long> allocation_count(0);
+
+static void* counted_alloc(std::size_t size){
+	allocation_count++;
+	if(void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+#if defined(__GNUC__)
+	#define RTW_NOINLINE __attribute__((noinline))
+#else
+	#define RTW_NOINLINE
+#endif
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+RTW_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+RTW_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+RTW_NOINLINE void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+RTW_NOINLINE void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// Set by a benchmark whose check fails; main then exits with status 1.
+static bool bench_failed = false;
+
+static double seconds_since(bench_clock::time_point start){
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static void report(const std::string& name, double amount, const char* unit, double seconds){
+	std::cout << std::left << std::setw(36) << name << std::right << std::setw(16)
+		<< std::fixed << std::setprecision(0) << amount / seconds << ' ' << unit << "/sec" << std::endl;
+}
+
+// Draws per second of one generator, first on one thread, then on every hardware
+// thread at once to expose contention on shared state.
+template<typename generator>
+static void bench_generator(const std::string& name){
+	const long draws = 20000000;
+	int threads = static_cast<int>(std::thread::hardware_concurrency());
+	threads = (threads < 1) ? 1 : threads;
+
+	auto run = [&](int thread_index){
+		generator g;
+		g.seed(thread_index);
+		double sum = 0;
+		for(long i=0; i<draws; ++i)
+			sum += g.next_double();
+		volatile double sink = sum;
+		(void)sink;
+	};
+
+	auto start = bench_clock::now();
+	run(0);
+	report(name + " (1 thread)", draws, "draws", seconds_since(start));
+
+	start = bench_clock::now();
+	std::vector<std::thread> pool;
+	for(int t=0; t<threads; ++t)
+		pool.emplace_back(run, t);
+	for(auto& thread : pool)
+		thread.join();
+	report(name + " (" + std::to_string(threads) + " threads)", static_cast<double>(draws) * threads, "draws", seconds_since(start));
+}
+
+static void bench_rng(){
+	bench_generator<c_rand>("rand()");
+	bench_generator<pcg32>("pcg32");
+	bench_generator<xoshiro256plus>("xoshiro256+");
+	bench_generator<squares>("squares (counter-based)");
+}
+
+// Samples per second on a reduced final scene with the generator chosen at build time
+// (-D RTW_RNG_RAND, -D RTW_RNG_PCG32, -D RTW_RNG_XOSHIRO, or squares by default).
+static void bench_render(){
+	material_table materials;
+	hittable_list world = final_scene(materials);
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 400;
+	cam.samples_per_pixel = 16;
+
+	auto start = bench_clock::now();
+	cam.render_image(world, materials);
+	double samples = 400.0 * static_cast<int>(400 / cam.aspect_ratio) * cam.samples_per_pixel;
+	report("final scene render", samples, "samples", seconds_since(start));
+}
+
+// Hardware cache counters for the calling thread, opened through perf_event_open the
+// same way `perf stat` does. Kernels that refuse access (containers, paranoid settings)
+// leave the counters closed and the report says so.
+class cache_counters{
+	public:
+		cache_counters(){
+#if defined(__linux__)
+			const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			open_counter(0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+			open_counter(1, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+			open_counter(2, PERF_TYPE_HW_CACHE, l1d_read_miss);
+#endif
+		}
+
+		~cache_counters(){
+#if defined(__linux__)
+			for(int fd : fds)
+				if(fd >= 0) close(fd);
+#endif
+		}
+
+		void start(){
+#if defined(__linux__)
+			for(int fd : fds){
+				if(fd < 0) continue;
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		void stop_and_report(const std::string& name, double per){
+			static const char* labels[3] = {"cache-references", "cache-misses", "L1-dcache-load-misses"};
+			bool any = false;
+			for(int i=0; i<3; ++i){
+				if(fds[i] < 0) continue;
+				uint64_t value = 0;
+#if defined(__linux__)
+				ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+				if(read(fds[i], &value, sizeof(value)) != sizeof(value)) continue;
+#endif
+				any = true;
+				std::cout << "  " << std::left << std::setw(34) << (name + " " + labels[i]) << std::right
+					<< std::setw(16) << std::setprecision(2) << value / per << " /ray" << std::endl;
+			}
+			if(!any)
+				std::cout << "  " << name << ": hardware counters unavailable (run under `perf stat -e cache-misses`)" << std::endl;
+		}
+
+	private:
+		int fds[3] = {-1, -1, -1};
+
+#if defined(__linux__)
+		void open_counter(int slot, uint32_t type, uint64_t config){
+			perf_event_attr attr = {};
+			attr.size = sizeof(attr);
+			attr.type = type;
+			attr.config = config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fds[slot] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+#endif
+};
+
+// Closest-hit queries per second for rays shot from outside the scene towards random
+// points inside its bounding box.
+static double rays_per_second(const hittable& world, long rays){
+	aabb box = world.bounding_box();
+	point3 eye = box.centroid() + vec3(0, 0, 2 * box.z.size() + 1);
+
+	long hits = 0;
+	auto start = bench_clock::now();
+	for(long i=0; i<rays; ++i){
+		point3 target(random_double(box.x.min, box.x.max), random_double(box.y.min, box.y.max), random_double(box.z.min, box.z.max));
+		hit_record rec;
+		hits += world.hit(ray(eye, target - eye), interval(0.001, infinity), rec);
+	}
+	volatile long sink = hits;
+	(void)sink;
+	return rays / seconds_since(start);
+}
+
+static void bench_bvh(){
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	bvh_node tree(scene);
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 400;
+	cam.samples_per_pixel = 4;
+	double samples = 400.0 * static_cast<int>(400 / cam.aspect_ratio) * cam.samples_per_pixel;
+
+	auto start = bench_clock::now();
+	cam.render_image(scene, materials);
+	report("final scene, list", samples, "samples", seconds_since(start));
+	start = bench_clock::now();
+	cam.render_image(tree, materials);
+	report("final scene, bvh", samples, "samples", seconds_since(start));
+
+	for(int n : {10000, 100000, 1000000}){
+		material_table materials;
+		hittable_list spheres = random_spheres(n, materials);
+		auto build_start = bench_clock::now();
+		bvh_node spheres_tree(spheres);
+		double build_time = seconds_since(build_start);
+
+		std::string size = std::to_string(n / 1000) + "k spheres";
+		report(size + ", list", rays_per_second(spheres, std::max(100L, 20000000L / n)), "rays", 1);
+		report(size + ", bvh", rays_per_second(spheres_tree, 200000), "rays", 1);
+		std::cout << size << " bvh build: " << build_time << " s" << std::endl;
+	}
+}
+
+// Pointer-based bvh_node against the flattened linear_bvh, with cache counters around
+// the traversal loops.
+static void bench_linear_bvh(){
+	for(int n : {100000, 1000000}){
+		material_table materials;
+		hittable_list spheres = random_spheres(n, materials);
+		bvh_node tree(spheres);
+		linear_bvh flat(tree);
+
+		std::string size = std::to_string(n / 1000) + "k spheres";
+		const long rays = 200000;
+		cache_counters counters;
+
+		counters.start();
+		report(size + ", bvh_node", rays_per_second(tree, rays), "rays", 1);
+		counters.stop_and_report("bvh_node", rays);
+
+		counters.start();
+		report(size + ", linear_bvh", rays_per_second(flat, rays), "rays", 1);
+		counters.stop_and_report("linear_bvh", rays);
+
+		std::cout << "  linear_bvh nodes: " << flat.node_count()
+			<< " (" << flat.node_count() * sizeof(linear_bvh_node) / 1024 << " KiB)" << std::endl;
+	}
+}
+
+// Shoots the same rays as rays_per_second at both worlds and counts the rays whose
+// closest hits differ in t or material. sphere_soa confirms its candidates in full
+// precision, so it should agree with sphere::hit exactly.
+static long hit_mismatches(const hittable& a, const hittable& b, long rays){
+	aabb box = a.bounding_box();
+	point3 eye = box.centroid() + vec3(0, 0, 2 * box.z.size() + 1);
+
+	long mismatches = 0;
+	for(long i=0; i<rays; ++i){
+		point3 target(random_double(box.x.min, box.x.max), random_double(box.y.min, box.y.max), random_double(box.z.min, box.z.max));
+		ray r(eye, target - eye);
+		hit_record rec_a, rec_b;
+		bool hit_a = a.hit(r, interval(0.001, infinity), rec_a);
+		bool hit_b = b.hit(r, interval(0.001, infinity), rec_b);
+		if(hit_a != hit_b || (hit_a && (rec_a.t != rec_b.t || rec_a.material_id != rec_b.material_id)))
+			mismatches++;
+	}
+	return mismatches;
+}
+
+// Reports and records a mismatch count from a correctness check next to the timings.
+static void check_mismatches(const std::string& name, long mismatches){
+	bench_failed = bench_failed || mismatches != 0;
+	std::cout << std::left << std::setw(36) << name
+		<< (mismatches ? std::to_string(mismatches) + " rays differ (MISMATCH)" : "same hits (ok)") << std::endl;
+}
+
+// One ray against every sphere: the sphere::hit loop of hittable_list against the
+// blocked sphere_soa kernel (AVX2, SSE or scalar, whichever this build selected).
+// Each pair is also checked hit for hit.
+static void bench_sphere_soa(){
+#if defined(RTW_SOA_AVX2)
+	std::cout << "sphere_soa kernel: AVX2, 8 wide" << std::endl;
+#elif defined(RTW_SOA_SSE)
+	std::cout << "sphere_soa kernel: SSE, 4 wide" << std::endl;
+#else
+	std::cout << "sphere_soa kernel: scalar" << std::endl;
+#endif
+
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	sphere_soa scene_soa(scene);
+	report("final scene, sphere::hit loop", rays_per_second(scene, 200000), "rays", 1);
+	report("final scene, sphere_soa", rays_per_second(scene_soa, 200000), "rays", 1);
+	check_mismatches("final scene, sphere_soa", hit_mismatches(scene, scene_soa, 200000));
+
+	hittable_list cloud = random_spheres(10000, materials);
+	sphere_soa cloud_soa(cloud);
+	report("10k spheres, sphere::hit loop", rays_per_second(cloud, 5000), "rays", 1);
+	report("10k spheres, sphere_soa", rays_per_second(cloud_soa, 5000), "rays", 1);
+	check_mismatches("10k spheres, sphere_soa", hit_mismatches(cloud, cloud_soa, 5000));
+}
+
+// Primary visibility only (max_depth 1) for a 4K frame of the final scene through
+// linear_bvh, with single rays and with 4x4 and 8x8 packets. Packet frames must match
+// the single-ray frame byte for byte.
+static void bench_packets(){
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	hittable_list world(make_shared<linear_bvh>(scene));
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 3840;
+	cam.samples_per_pixel = 1;
+	cam.max_depth = 1;
+	double rays = 3840.0 * static_cast<int>(3840 / cam.aspect_ratio);
+
+	std::vector<color> single;
+	for(int size : {0, 4, 8}){
+		cam.packet_size = size;
+		auto start = bench_clock::now();
+		framebuffer image = cam.render_image(world, materials);
+		std::string name = size ? "4K primary rays, " + std::to_string(size) + "x" + std::to_string(size) + " packets" : "4K primary rays, single";
+		report(name, rays, "rays", seconds_since(start));
+		if(size == 0){
+			single = image.pixels;
+		}else if(image.pixels.size() != single.size()
+				|| std::memcmp(image.pixels.data(), single.data(), single.size() * sizeof(color)) != 0){
+			std::cout << "  (MISMATCH)" << std::endl;
+			bench_failed = true;
+		}
+	}
+}
+
+// Full path tracing of the final scene through linear_bvh, recursively per sample and
+// as a wavefront with several queue sizes. The wavefront rows also print stage times.
+static void bench_wavefront(){
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	hittable_list world(make_shared<linear_bvh>(scene));
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 400;
+	cam.samples_per_pixel = 16;
+	double samples = 400.0 * static_cast<int>(400 / cam.aspect_ratio) * cam.samples_per_pixel;
+
+	auto start = bench_clock::now();
+	cam.render_image(world, materials);
+	report("recursive", samples, "samples", seconds_since(start));
+
+	cam.wavefront = true;
+	for(size_t paths : {size_t(1) << 14, size_t(1) << 17, size_t(1) << 20}){
+		cam.wavefront_paths = paths;
+		start = bench_clock::now();
+		cam.render_image(world, materials);
+		report("wavefront, " + std::to_string(paths) + " paths", samples, "samples", seconds_since(start));
+	}
+}
+
+// Renders the same frame at two sample counts and checks that the extra samples made
+// no heap allocations: everything a sample touches lives on the stack or in buffers
+// sized once per frame.
+static void bench_allocations(){
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	hittable_list world(make_shared<linear_bvh>(scene));
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 64;
+	cam.num_threads = 1;
+
+	for(int packet_size : {0, 8}){
+		cam.packet_size = packet_size;
+		long counts[2];
+		int spp[2] = {1, 17};
+		for(int k = 0; k < 2; k++){
+			cam.samples_per_pixel = spp[k];
+			long before = allocation_count;
+			cam.render_image(world, materials);
+			counts[k] = allocation_count - before;
+		}
+		bench_failed = bench_failed || counts[1] != counts[0];
+		double per_sample = static_cast<double>(counts[1] - counts[0]) / (64.0 * static_cast<int>(64 / cam.aspect_ratio) * (spp[1] - spp[0]));
+		std::cout << (packet_size ? "packet render" : "single ray render") << ": " << counts[0] << " allocations at "
+			<< spp[0] << " spp, " << counts[1] << " at " << spp[1] << " spp, " << per_sample << " per sample "
+			<< (counts[1] == counts[0] ? "(ok)" : "(FAILED)") << std::endl;
+	}
+}
+
+// Writing a 4K frame: the old per-pixel P3 text stream against the binary encoders,
+// each saved to a scratch file in the working directory that is removed afterwards.
+static void bench_output(){
+	framebuffer image(3840, 2160);
+	for(auto& c : image.pixels)
+		c = color::random() * 16;
+	const int spp = 16;
+	double pixels = static_cast<double>(image.width) * image.height;
+
+	auto start = bench_clock::now();
+	{
+		std::ofstream out("bench_output_p3.ppm");
+		out << "P3\n" << image.width << ' ' << image.height << "\n255\n";
+		for(const auto& c : image.pixels){
+			out << static_cast<int>(to_byte(c.x() / spp)) << ' '
+				<< static_cast<int>(to_byte(c.y() / spp)) << ' '
+				<< static_cast<int>(to_byte(c.z() / spp)) << '\n';
+		}
+	}
+	report("4K P3 text, per pixel", pixels, "pixels", seconds_since(start));
+	std::remove("bench_output_p3.ppm");
+
+	for(const char* path : {"bench_output.ppm", "bench_output.pfm", "bench_output.png"}){
+		start = bench_clock::now();
+		bool ok = save_image(path, image, spp);
+		double seconds = seconds_since(start);
+		bench_failed = bench_failed || !ok;
+		size_t size = encoded_size(image, format_for(path));
+		report(std::string("4K ") + (path + 13) + (size >= mapped_output_threshold && mapped_file::supported() ? ", mapped" : ", buffered")
+			+ (ok ? "" : " (FAILED)"), pixels, "pixels", seconds);
+		std::remove(path);
+	}
+}
+
+// Root mean square difference of the displayed (gamma corrected) values of two images.
+static double display_rmse(const framebuffer& a, int a_spp, const framebuffer& b, int b_spp){
+	double sum = 0;
+	for(size_t i=0; i<a.pixels.size(); ++i){
+		color ca = a.average(i, a_spp), cb = b.average(i, b_spp);
+		for(int c = 0; c < 3; c++){
+			double d = linear_to_gamma(std::max<real>(ca[c], 0)) - linear_to_gamma(std::max<real>(cb[c], 0));
+			sum += d * d;
+		}
+	}
+	return std::sqrt(sum / (3.0 * a.pixels.size()));
+}
+
+// Error against a 1024 spp reference of the final scene for uniform and adaptive
+// sampling at the same average budgets, and the time each needs to get below a target.
+// Also saves the adaptive spp heatmap of the 32 spp run as bench_heatmap.png.
+static void bench_adaptive(){
+	const double target = 0.02;
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	hittable_list world(make_shared<linear_bvh>(scene));
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 160;
+	cam.samples_per_pixel = 1024;
+	framebuffer reference = cam.render_image(world, materials);
+
+	for(bool adaptive : {false, true}){
+		const char* mode = adaptive ? "adaptive" : "uniform";
+		double time_to_target = -1;
+		for(int spp : {4, 8, 16, 32, 64, 128}){
+			cam.samples_per_pixel = spp;
+			cam.adaptive = adaptive;
+			auto start = bench_clock::now();
+			framebuffer image = cam.render_image(world, materials);
+			double seconds = seconds_since(start);
+			if(adaptive && spp == 32)
+				save_image("bench_heatmap.png", image.sample_heatmap(), 1);
+			double error = display_rmse(image, spp, reference, 1024);
+			if(time_to_target < 0 && error <= target)
+				time_to_target = seconds;
+			std::cout << std::left << std::setw(36) << (std::string(mode) + ", " + std::to_string(spp) + " spp") << std::right
+				<< "rmse " << std::setprecision(4) << error << ", " << std::setprecision(3) << seconds << " s" << std::endl;
+		}
+		std::cout << mode << ": " << (time_to_target < 0 ? std::string("target not reached")
+			: "rmse " + std::to_string(target) + " reached in " + std::to_string(time_to_target) + " s") << std::endl;
+	}
+}
+
+// Saves a scene of a million small spheres in both scene file forms, then times loading
+// each one and building the CPU world from it.
+static void bench_scene_file(){
+	const int n = 1000000;
+	scene_file scene;
+	scene.reserve(64, n);
+	for(int i=0; i<64; ++i){
+		color albedo = color::random();
+		scene.add_material(scene_material{static_cast<uint32_t>(i % 3),
+			{float(albedo.x()), float(albedo.y()), float(albedo.z())}, float(0.3 * random_double()), 1.5f});
+	}
+	auto side = 10 * std::cbrt(static_cast<double>(n));
+	for(int i=0; i<n; ++i){
+		point3 c = vec3::random(-side/2, side/2);
+		scene.add_sphere(float(c.x()), float(c.y()), float(c.z()), 0.4f, static_cast<uint32_t>(i % 64));
+	}
+	const char* text_path = "bench_scene.txt";
+	const char* binary_path = "bench_scene.bin";
+	scene.save_text(text_path);
+	scene.save_binary(binary_path);
+
+	for(const char* path : {binary_path, text_path}){
+		scene_file loaded;
+		auto start = bench_clock::now();
+		bool ok = loaded.load(path);
+		double load_seconds = seconds_since(start);
+		start = bench_clock::now();
+		material_table materials;
+		hittable_list world = scene_world(loaded, materials);
+		double world_seconds = seconds_since(start);
+		bool same = ok && loaded.sphere_count() == scene.sphere_count()
+			&& std::memcmp(loaded.spheres(), scene.spheres(), n * sizeof(scene_sphere)) == 0;
+		bench_failed = bench_failed || !same;
+		std::cout << std::left << std::setw(36) << (std::string("1M spheres, ") + (path == binary_path ? (loaded.is_mapped() ? "binary, mapped" : "binary, read") : "text"))
+			<< std::right << std::setprecision(3) << "load " << load_seconds * 1000 << " ms, world " << world_seconds * 1000 << " ms"
+			<< (ok ? (same ? "" : " (MISMATCH)") : " (FAILED: " + loaded.error() + ")") << std::endl;
+	}
+	std::remove(text_path);
+	std::remove(binary_path);
+
+	// A scene with nothing but comments is valid and empty, and its world hits nothing.
+	const char* empty_path = "bench_scene_empty.txt";
+	std::ofstream(empty_path) << "# nothing\n";
+	scene_file empty;
+	bool loaded = empty.load(empty_path);
+	material_table materials;
+	linear_bvh tree(scene_world(empty, materials));
+	hit_record rec;
+	bool ok = loaded && empty.sphere_count() == 0
+		&& !tree.hit(ray(point3(0, 0, 0), vec3(0, 0, -1)), interval(0.001, infinity), rec);
+	bench_failed = bench_failed || !ok;
+	std::cout << std::left << std::setw(36) << "comment-only scene" << (ok ? "empty (ok)" : "(FAILED)") << std::endl;
+	std::remove(empty_path);
+}
+
+// A sphere of the row bench_material_ids traces, with its material both ways.
+struct row_sphere{
+	point3 center;
+	real radius;
+	shared_ptr<material> mat;
+	uint32_t material_id;
+};
+
+// A hit record as spheres filled it before the material table: the surface computed and
+// the material's shared_ptr copied for every hit closer than the last.
+struct shared_material_hit{
+	real t;
+	point3 p;
+	vec3 normal;
+	bool front_face;
+	shared_ptr<material> mat;
+};
+
+static bool row_root(const row_sphere& s, const ray& r, const interval& ray_t, real& root){
+	vec3 oc = r.origin() - s.center;
+	auto a = r.direction().length_squared();
+	auto h_b = dot(oc, r.direction());
+	auto disc = h_b*h_b - a*(oc.length_squared() - s.radius*s.radius);
+	if(disc < 0)
+		return false;
+	root = (-h_b - sqrt(disc))/a;
+	if(!ray_t.surrounds(root))
+		root = (-h_b + sqrt(disc))/a;
+	return ray_t.surrounds(root);
+}
+
+// Candidate hits per second when every closer hit copies a shared_ptr<material> into the
+// record, the way spheres recorded hits before the material table, against copying a
+// material id and filling the surface once for the closest hit. The spheres sit in a row
+// along the rays, farthest first, so every sphere tested is a new closest hit, and they
+// share one material, so on several threads every copy lands on the same reference count.
+static void bench_material_ids(){
+	const int row = 64;
+	const long rays = 200000;
+	int threads = static_cast<int>(std::thread::hardware_concurrency());
+	threads = (threads < 1) ? 1 : threads;
+
+	material_table materials;
+	auto grey = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+	uint32_t grey_id = materials.add(*grey);
+	std::vector<row_sphere> spheres;
+	for(int k=0; k<row; ++k)
+		spheres.push_back({point3(0, 0, -2.0 * (row - k)), 0.9, grey, grey_id});
+
+	auto trace = [&](bool shared, int thread_index){
+		pcg32 g;
+		g.seed(thread_index);
+		double sum = 0;
+		for(long i=0; i<rays; ++i){
+			ray r(point3(0, 0, 0), vec3(0.01 * (g.next_double() - 0.5), 0.01 * (g.next_double() - 0.5), -1));
+			interval ray_t(0.001, infinity);
+			real root;
+			if(shared){
+				shared_material_hit rec;
+				for(const auto& s : spheres){
+					if(row_root(s, r, ray_t, root)){
+						rec.t = ray_t.max = root;
+						rec.p = r.at(root);
+						vec3 outward_normal = (rec.p - s.center) / s.radius;
+						rec.front_face = dot(r.direction(), outward_normal) < 0;
+						rec.normal = rec.front_face ? outward_normal : -outward_normal;
+						rec.mat = s.mat;
+					}
+				}
+				sum += rec.normal.z() + (rec.mat ? 1 : 0);
+			}else{
+				hit_record rec;
+				const row_sphere* closest = nullptr;
+				for(const auto& s : spheres){
+					if(row_root(s, r, ray_t, root)){
+						rec.t = ray_t.max = root;
+						rec.material_id = s.material_id;
+						closest = &s;
+					}
+				}
+				if(closest){
+					rec.p = r.at(rec.t);
+					rec.set_face_normal(r, (rec.p - closest->center) / closest->radius);
+					sum += rec.normal.z() + rec.material_id;
+				}
+			}
+		}
+		volatile double sink = sum;
+		(void)sink;
+	};
+
+	for(bool shared : {true, false}){
+		std::string name = shared ? "shared_ptr per hit" : "material id, lazy fill";
+		auto start = bench_clock::now();
+		trace(shared, 0);
+		report(name + " (1 thread)", static_cast<double>(rays) * row, "hits", seconds_since(start));
+
+		start = bench_clock::now();
+		std::vector<std::thread> pool;
+		for(int t=0; t<threads; ++t)
+			pool.emplace_back(trace, shared, t);
+		for(auto& thread : pool)
+			thread.join();
+		report(name + " (" + std::to_string(threads) + " threads)", static_cast<double>(rays) * row * threads, "hits", seconds_since(start));
+	}
+}
+
+// Scatters per second over a batch of hits on 64 materials of random kinds: through the
+// virtual material::scatter the camera used to call, through material_table's variant,
+// and through the variant after grouping the batch by material kind, counting the time
+// the grouping takes. Then wavefront renders of the final scene with and without sorting.
+static void bench_material_dispatch(){
+	const size_t batch = size_t(1) << 16;
+	const int rounds = 40;
+
+	material_table table;
+	std::vector<shared_ptr<material>> virtuals;
+	for(int i=0; i<64; ++i){
+		color albedo = color::random();
+		int kind = static_cast<int>(3 * random_double());
+		if(kind == 0){
+			table.add(lambertian(albedo));
+			virtuals.push_back(make_shared<lambertian>(albedo));
+		}else if(kind == 1){
+			table.add(metal(albedo, 0.3));
+			virtuals.push_back(make_shared<metal>(albedo, 0.3));
+		}else{
+			table.add(dielectric(1.5));
+			virtuals.push_back(make_shared<dielectric>(1.5));
+		}
+	}
+
+	std::vector<ray> rays(batch);
+	std::vector<hit_record> recs(batch);
+	for(size_t i=0; i<batch; ++i){
+		vec3 normal = random_unit_vector();
+		rays[i] = ray(point3(0, 0, 0), -normal + 0.5 * random_unit_vector());
+		recs[i].t = 1;
+		recs[i].material_id = static_cast<uint32_t>(64 * random_double());
+		recs[i].p = rays[i].at(1);
+		recs[i].set_face_normal(rays[i], normal);
+	}
+
+	auto run = [&](const std::string& name, auto scatter_one, bool sorted){
+		std::vector<uint32_t> order(batch), keys(batch);
+		double sum = 0;
+		auto start = bench_clock::now();
+		for(int round = 0; round < rounds; round++){
+			if(sorted){
+				size_t starts[material_kinds + 1] = {};
+				for(size_t i=0; i<batch; ++i){
+					keys[i] = table.kind(recs[i].material_id);
+					starts[keys[i] + 1]++;
+				}
+				for(size_t k = 1; k <= material_kinds; ++k)
+					starts[k] += starts[k - 1];
+				for(size_t i=0; i<batch; ++i)
+					order[starts[keys[i]]++] = static_cast<uint32_t>(i);
+			}else{
+				for(size_t i=0; i<batch; ++i)
+					order[i] = static_cast<uint32_t>(i);
+			}
+			for(uint32_t i : order){
+				ray scattered;
+				color attenuation;
+				if(scatter_one(rays[i], recs[i], attenuation, scattered))
+					sum += attenuation.x() + scattered.direction().y();
+			}
+		}
+		report(name, static_cast<double>(batch) * rounds, "scatters", seconds_since(start));
+		volatile double sink = sum;
+		(void)sink;
+	};
+
+	auto virtual_call = [&](const ray& r, const hit_record& rec, color& attenuation, ray& scattered){
+		return virtuals[rec.material_id]->scatter(r, rec, attenuation, scattered);
+	};
+	auto variant_call = [&](const ray& r, const hit_record& rec, color& attenuation, ray& scattered){
+		return table.scatter(rec.material_id, r, rec, attenuation, scattered);
+	};
+	run("virtual", virtual_call, false);
+	run("virtual, sorted by kind", virtual_call, true);
+	run("variant", variant_call, false);
+	run("variant, sorted by kind", variant_call, true);
+
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	hittable_list world(make_shared<linear_bvh>(scene));
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 400;
+	cam.samples_per_pixel = 16;
+	cam.wavefront = true;
+	double samples = 400.0 * static_cast<int>(400 / cam.aspect_ratio) * cam.samples_per_pixel;
+	for(bool sort : {false, true}){
+		cam.wavefront_sort = sort;
+		auto start = bench_clock::now();
+		cam.render_image(world, materials);
+		report(sort ? "wavefront, sorted by kind" : "wavefront, queue order", samples, "samples", seconds_since(start));
+	}
+}
+
+// The generic tile loop against the kernel specialised for each lens and depth, on the
+// final scene through linear_bvh, checking that both render the same image. Depth 50
+// has no kernel of its own and shows the lens specialisation alone.
+static void bench_kernels(){
+	material_table materials;
+	hittable_list scene = final_scene(materials);
+	hittable_list world(make_shared<linear_bvh>(scene));
+
+	camera cam;
+	final_scene_camera(cam);
+	cam.width = 320;
+	cam.samples_per_pixel = 8;
+	double samples = 320.0 * static_cast<int>(320 / cam.aspect_ratio) * cam.samples_per_pixel;
+
+	for(real defocus_angle : {0.0, 0.6}){
+		cam.defocus_angle = defocus_angle;
+		for(int depth : {1, 2, 4, 8, 50}){
+			cam.max_depth = depth;
+			std::string name = std::string(defocus_angle > 0 ? "thin lens" : "pinhole") + ", depth " + std::to_string(depth);
+
+			cam.specialized_kernels = false;
+			auto start = bench_clock::now();
+			framebuffer generic = cam.render_image(world, materials);
+			report(name + ", generic", samples, "samples", seconds_since(start));
+
+			cam.specialized_kernels = true;
+			start = bench_clock::now();
+			framebuffer specialized = cam.render_image(world, materials);
+			report(name + ", kernel", samples, "samples", seconds_since(start));
+			if(specialized.pixels.size() != generic.pixels.size()
+					|| std::memcmp(specialized.pixels.data(), generic.pixels.data(), generic.pixels.size() * sizeof(color)) != 0){
+				std::cout << "  (MISMATCH)" << std::endl;
+				bench_failed = true;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv){
+	const std::vector<std::pair<const char*, std::function<void()>>> benchmarks = {
+		{"rng", bench_rng},
+		{"render", bench_render},
+		{"bvh", bench_bvh},
+		{"lbvh", bench_linear_bvh},
+		{"soa", bench_sphere_soa},
+		{"packet", bench_packets},
+		{"wavefront", bench_wavefront},
+		{"alloc", bench_allocations},
+		{"output", bench_output},
+		{"adaptive", bench_adaptive},
+		{"scene", bench_scene_file},
+		{"materials", bench_material_ids},
+		{"dispatch", bench_material_dispatch},
+		{"kernels", bench_kernels},
+	};
+
+	for(const auto& b : benchmarks){
+		bool selected = (argc < 2);
+		for(int i=1; i<argc; ++i)
+			selected = selected || std::strcmp(argv[i], b.first) == 0;
+		if(selected){
+			std::cout << "== " << b.first << std::endl;
+			b.second();
+		}
+	}
+	return bench_failed ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <vector>
+
+class bvh_node : public hittable{
+	public:
+		bvh_node(const hittable_list& list) : bvh_node(list.objects) {}
+
+		bvh_node(std::vector<shared_ptr<hittable>> objects) : bvh_node(objects, 0, objects.size(), 0) {}
+
+		bool hit(const ray& r, interval ray_t, hit_record& rec) const override{
+			if(!left || !bbox.hit(r, ray_t))
+				return false;
+
+			if(left == right)
+				return left->hit(r, ray_t, rec);
+
+			// Visit the child nearer along the split axis first so the far one can be
+			// culled against the closer hit.
+			bool reversed = r.direction()[axis] < 0;
+			const hittable& first = reversed ? *right : *left;
+			const hittable& second = reversed ? *left : *right;
+
+			bool hit_first = first.hit(r, ray_t, rec);
+			bool hit_second = second.hit(r, interval(ray_t.min, hit_first ? rec.t : ray_t.max), rec);
+
+			return hit_first || hit_second;
+		}
+
+		aabb bounding_box() const override { return bbox; }
+
+	private:
+		friend class linear_bvh;
+
+		static const int bin_count = 16;
+		// Below this depth nodes split by count instead of by SAH. Each such split halves
+		// the range, so no tree over 2^32 objects gets deeper than max_sah_depth + 32,
+		// which keeps it within linear_bvh's traversal stack.
+		static const int max_sah_depth = 32;
+
+		// Both null for a tree over no objects, which nothing hits.
+		shared_ptr<hittable> left;
+		shared_ptr<hittable> right;
+		aabb bbox;
+		int axis = 0;
+
+		bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, int depth){
+			aabb centroid_bounds;
+			for(size_t i=start; i<end; ++i){
+				bbox = aabb(bbox, objects[i]->bounding_box());
+				point3 c = objects[i]->bounding_box().centroid();
+				centroid_bounds = aabb(centroid_bounds, aabb(c, c));
+			}
+
+			size_t span = end - start;
+			axis = centroid_bounds.longest_axis();
+
+			if(span == 0)
+				return;
+			if(span == 1){
+				left = right = objects[start];
+				return;
+			}
+
+			size_t mid = (span == 2) ? start + 1 : (depth < max_sah_depth) ? sah_split(objects, start, end, centroid_bounds) : start;
+			if(mid == start || mid == end){
+				// Coincident centroids, or too deep for SAH: split by count.
+				mid = start + span/2;
+				std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end,
+					[this](const shared_ptr<hittable>& a, const shared_ptr<hittable>& b){
+						return centroid_of(a) < centroid_of(b);
+					});
+			}else if(span == 2 && centroid_of(objects[start]) > centroid_of(objects[start + 1])){
+				std::swap(objects[start], objects[start + 1]);
+			}
+
+			left = make_child(objects, start, mid, depth + 1);
+			right = make_child(objects, mid, end, depth + 1);
+		}
+
+		double centroid_of(const shared_ptr<hittable>& object) const{
+			return object->bounding_box().centroid()[axis];
+		}
+
+		static shared_ptr<hittable> make_child(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, int depth){
+			if(end - start == 1)
+				return objects[start];
+			return shared_ptr<bvh_node>(new bvh_node(objects, start, end, depth));
+		}
+
+		// Bins the centroids along every axis and picks the plane with the lowest surface
+		// area heuristic cost, then partitions the range around it. Sets axis to the chosen
+		// axis and returns the first index of the right half.
+		size_t sah_split(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, const aabb& centroid_bounds){
+			double best_cost = infinity;
+			int best_axis = -1;
+			int best_bin = 0;
+
+			for(int a = 0; a < 3; a++){
+				const interval& extent = centroid_bounds.axis(a);
+				if(extent.size() <= 0)
+					continue;
+
+				aabb bin_bounds[bin_count];
+				size_t bin_counts[bin_count] = {};
+				for(size_t i=start; i<end; ++i){
+					aabb box = objects[i]->bounding_box();
+					int b = bin_index(box.centroid()[a], extent);
+					bin_bounds[b] = aabb(bin_bounds[b], box);
+					bin_counts[b]++;
+				}
+
+				// Sweep from the right to get the cost of every right half, then from the left.
+				double right_area[bin_count];
+				size_t right_count[bin_count];
+				aabb acc;
+				size_t count = 0;
+				for(int b = bin_count - 1; b > 0; b--){
+					acc = aabb(acc, bin_bounds[b]);
+					count += bin_counts[b];
+					right_area[b] = acc.surface_area();
+					right_count[b] = count;
+				}
+
+				acc = aabb();
+				count = 0;
+				for(int b = 1; b < bin_count; b++){
+					acc = aabb(acc, bin_bounds[b - 1]);
+					count += bin_counts[b - 1];
+					if(count == 0 || right_count[b] == 0)
+						continue;
+					double cost = acc.surface_area()*count + right_area[b]*right_count[b];
+					if(cost < best_cost){
+						best_cost = cost;
+						best_axis = a;
+						best_bin = b;
+					}
+				}
+			}
+
+			if(best_axis < 0)
+				return start;
+
+			axis = best_axis;
+			const interval& extent = centroid_bounds.axis(axis);
+			auto split = std::partition(objects.begin() + start, objects.begin() + end,
+				[&](const shared_ptr<hittable>& object){
+					return bin_index(object->bounding_box().centroid()[axis], extent) < best_bin;
+				});
+			return static_cast<size_t>(split - objects.begin());
+		}
+
+		static int bin_index(double centroid, const interval& extent){
+			int b = static_cast<int>(bin_count * (centroid - extent.min) / extent.size());
+			return (b < 0) ? 0 : (b >= bin_count ? bin_count - 1 : b);
+		}
+};
+
+#endif
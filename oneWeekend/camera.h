@@ -3,44 +3,149 @@
 
 #include "rtweekend.h"
 
+#include "checkpoint.h"
 #include "color.h"
+#include "framebuffer.h"
 #include "hittable.h"
+#include "image_writer.h"
 #include "material.h"
+#include "tile_scheduler.h"
+#include "wavefront.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+	#include <fcntl.h>
+	#include <io.h>
+#endif
 
 class camera{
 	public:
-		double aspect_ratio = 1.0;
+		real aspect_ratio = 1.0;
 		int width = 100;
 		int samples_per_pixel = 10;
 		int max_depth = 10;
 
-		double vfov = 90;
+		real vfov = 90;
 		point3 lookfrom = point3(0,0,-1);
 		point3 lookat = point3(0,0,0);
 		vec3 vup = vec3(0,1,0);
 
-		double defocus_angle = 0;
-		double focus_dist = 10;
+		real defocus_angle = 0;
+		real focus_dist = 10;
+
+		int num_threads = 0;	// 0 uses every hardware thread
+		int tile_size = 16;
+		uint64_t seed = 0;
+
+		// Side of the square ray packets used for primary rays (4 or 8); 0 traces single rays.
+		// Secondary rays are always traced one by one. Ignored by wavefront, progressive and
+		// adaptive renders, which trace single rays.
+		int packet_size = 0;
+
+		// Renders with separate batched generate/extend/shade/connect stages over a queue
+		// of up to wavefront_paths paths instead of tracing each sample to completion.
+		// wavefront_sort shades the paths of each bounce grouped by material kind instead
+		// of in queue order; the image is the same either way.
+		bool wavefront = false;
+		size_t wavefront_paths = 1 << 20;
+		bool wavefront_sort = true;
+		wavefront_stats last_wavefront_stats;
+
+		// First bounce at which paths may be terminated by Russian roulette; 0 disables it.
+		int roulette_depth = 5;
+
+		// Adaptive sampling keeps samples_per_pixel as the average budget of every tile but
+		// hands it out unevenly: each pixel first takes adaptive_min_samples, then the rest
+		// goes in rounds to the pixels whose on-screen standard error is still above
+		// adaptive_threshold (in display units, 1/255 is one 8-bit step). The budget does not
+		// move between tiles: samples saved on converged pixels only go to other pixels of
+		// the same tile, so a tile of flat sky finishes early while a noisy tile still stops
+		// at its own share, whatever the rest of the image left over. Adaptive tiles are
+		// traced with single rays, so adaptive takes precedence over packet_size; wavefront
+		// and progressive renders take precedence over adaptive. heatmap_path, when set,
+		// receives the samples taken per pixel.
+		bool adaptive = false;
+		int adaptive_min_samples = 0;	// 0 takes half of samples_per_pixel up front
+		real adaptive_threshold = 0.005;
+		std::string heatmap_path;
+
+		// Progressive rendering builds the image in passes of pass_samples samples per pixel
+		// up to samples_per_pixel. With checkpoint_path set, the accumulated radiance, the
+		// samples per pixel and the seed are saved there every checkpoint_interval seconds
+		// and when the render stops, and a render that finds a checkpoint of the same image
+		// resumes from it. time_limit (seconds, 0 for none) stops at a wall-clock deadline
+		// with the image accumulated so far. Adaptive sampling does not apply.
+		bool progressive = false;
+		int pass_samples = 1;
+		std::string checkpoint_path;
+		double checkpoint_interval = 60;
+		double time_limit = 0;
+
+		// Plain tile renders (not adaptive, packets, wavefront or progressive) go through
+		// a kernel compiled for the lens, pinhole or thin lens, and for max_depth when it
+		// is 1, 2, 4 or 8, picked once per render. Turning this off keeps the
+		// generic loop, which checks both per ray; the images are the same.
+		bool specialized_kernels = true;
 		
-		void render(const hittable& world){
+		void render(const hittable& world, const material_table& materials){
+			framebuffer image = render_image(world, materials);
+#if defined(_WIN32)
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			write_image(std::cout, image, samples_per_pixel, image_format::ppm);
+			save_heatmap(image);
+		}
+
+		// Renders and saves to path, in the format its extension names (.ppm, .pfm or .png).
+		bool render(const hittable& world, const material_table& materials, const std::string& path){
+			framebuffer image = render_image(world, materials);
+			return save_image(path, image, samples_per_pixel) && save_heatmap(image);
+		}
+
+		framebuffer render_image(const hittable& world, const material_table& materials){
 			initialize();
+			scene_materials = &materials;
+			tile_kernel = specialized_kernels ? select_kernel() : nullptr;
 
-			std::cout << "P3\n" << width << ' ' << height << "\n255\n";
+			framebuffer image(width, height);
+			if((adaptive || progressive) && !wavefront)
+				image.samples.resize(image.pixels.size());
+			auto tiles = make_tiles(width, height, tile_size);
+			std::atomic<int> tiles_remaining(static_cast<int>(tiles.size()));
+			std::mutex log_lock;
 
-			for(int i=0; i<height; ++i){
-				std::clog << "\rScanlines remaining: " << (height - i) << ' ' << std::flush;
-				for(int j=0; j<width; ++j){
-					color pixel_color(0,0,0);
-					for(int sample = 0; sample < samples_per_pixel; sample++){
-						ray r = get_ray(j, i);
-						pixel_color += ray_color(r, max_depth, world);
-					}
-					write_color(std::cout, pixel_color, samples_per_pixel);
-				}
+			auto start = std::chrono::steady_clock::now();
+			tile_scheduler scheduler(num_threads);
+			long resumed = 0;
+			if(wavefront){
+				render_wavefront(world, scheduler, image);
+			}else if(progressive){
+				resumed = render_progressive(world, scheduler, image);
+			}else{
+				scheduler.run(tiles, [&](const tile& t){
+					render_tile(t, world, image);
+					int remaining = --tiles_remaining;
+					std::lock_guard<std::mutex> guard(log_lock);
+					std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush;
+				});
 			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
+			double samples = static_cast<double>(image.total_samples(samples_per_pixel) - resumed);
+			std::clog << "\rDone in " << elapsed.count() << " s ("
+				<< samples / elapsed.count() << " samples/sec on "
+				<< scheduler.threads() << " threads).\n";
+
+			return image;
 		}
 
 	private:
@@ -52,6 +157,10 @@ class camera{
 		vec3 u, v, w;
 		vec3 defocus_disk_u;
 		vec3 defocus_disk_v;
+		const material_table* scene_materials = nullptr;	// of the render in progress
+
+		using kernel = void (camera::*)(const tile&, const hittable&, framebuffer&) const;
+		kernel tile_kernel = nullptr;
 		
 		void initialize(){
 			height = static_cast<int>(width/aspect_ratio);
@@ -82,11 +191,436 @@ class camera{
 			defocus_disk_v = v * defocus_radius;
 		}
 
+		uint64_t pixel_key(int i, int j) const{
+			return seed ^ mix_bits(static_cast<uint64_t>(i) * width + j);
+		}
+
+		// Returns the samples that were loaded from a checkpoint rather than rendered.
+		long render_progressive(const hittable& world, tile_scheduler& scheduler, framebuffer& image) const{
+			using clock = std::chrono::steady_clock;
+			auto start = clock::now();
+			auto deadline = (time_limit > 0)
+				? start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(time_limit))
+				: clock::time_point::max();
+			auto last_checkpoint = start;
+			auto tiles = make_tiles(width, height, tile_size);
+			int step = std::max(1, pass_samples);
+
+			checkpoint_header header = make_checkpoint_header();
+			checkpoint_header found;
+			double earlier_seconds = 0;
+			long resumed = 0;
+			if(!checkpoint_path.empty() && load_checkpoint(checkpoint_path, header, image, found)){
+				earlier_seconds = found.seconds;
+				resumed = image.total_samples(samples_per_pixel);
+				std::clog << "Resuming " << checkpoint_path << " at " << fewest_samples(image) << " of "
+					<< samples_per_pixel << " samples per pixel.\n";
+			}
+
+			auto checkpoint = [&]{
+				if(checkpoint_path.empty())
+					return;
+				header.seconds = earlier_seconds + std::chrono::duration<double>(clock::now() - start).count();
+				if(!save_checkpoint(checkpoint_path, header, image))
+					std::clog << "\nCould not write checkpoint " << checkpoint_path << '\n';
+				last_checkpoint = clock::now();
+			};
+
+			// Each pass brings every pixel up to the next multiple of the pass size, so pixels
+			// left behind by a deadline in the middle of a pass catch up first.
+			int fewest;
+			while((fewest = fewest_samples(image)) < samples_per_pixel && clock::now() < deadline){
+				int target = std::min(samples_per_pixel, (fewest / step + 1) * step);
+				scheduler.run(tiles, [&](const tile& t){
+					if(clock::now() < deadline)
+						render_tile_progressive(t, world, image, target);
+				});
+				std::clog << "\rSamples per pixel: " << fewest_samples(image) << " of " << samples_per_pixel << ' ' << std::flush;
+
+				if(std::chrono::duration<double>(clock::now() - last_checkpoint).count() >= checkpoint_interval)
+					checkpoint();
+			}
+			if(clock::now() >= deadline)
+				std::clog << "\rTime limit reached at " << fewest_samples(image) << " samples per pixel.\n";
+			checkpoint();
+			return resumed;
+		}
+
+		void render_tile_progressive(const tile& t, const hittable& world, framebuffer& image, int target) const{
+			for(int i=t.y0; i<t.y1; ++i){
+				for(int j=t.x0; j<t.x1; ++j){
+					size_t index = static_cast<size_t>(i) * width + j;
+					int first = image.samples[index];
+					if(first >= target)
+						continue;
+					thread_rng().seed(pixel_key(i, j));
+					color pixel_color = image.pixels[index];
+					for(int sample = first; sample < target; sample++){
+						thread_rng().set_sample(sample);
+						pixel_color += ray_color(get_ray(j, i), world);
+					}
+					image.pixels[index] = pixel_color;
+					image.samples[index] = target;
+				}
+			}
+		}
+
+		static int fewest_samples(const framebuffer& image){
+			int fewest = std::numeric_limits<int>::max();
+			for(int n : image.samples)
+				fewest = std::min(fewest, n);
+			return image.samples.empty() ? 0 : fewest;
+		}
+
+		// Identifies the image a checkpoint belongs to; the scene itself is not hashed, so
+		// resuming with a different scene is the caller's mistake to avoid.
+		checkpoint_header make_checkpoint_header() const{
+			checkpoint_header header;
+			header.width = static_cast<uint32_t>(width);
+			header.height = static_cast<uint32_t>(height);
+			header.samples_per_pixel = static_cast<uint32_t>(samples_per_pixel);
+			header.seed = seed;
+
+			double settings[] = {aspect_ratio, vfov, lookfrom.x(), lookfrom.y(), lookfrom.z(),
+				lookat.x(), lookat.y(), lookat.z(), vup.x(), vup.y(), vup.z(), defocus_angle, focus_dist,
+				static_cast<double>(max_depth), static_cast<double>(roulette_depth)};
+			uint64_t key = 0;
+			for(double value : settings){
+				uint64_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				key = mix_bits(key ^ bits);
+			}
+			header.camera_key = key;
+			return header;
+		}
+
+		bool save_heatmap(const framebuffer& image) const{
+			if(heatmap_path.empty() || image.samples.empty())
+				return true;
+			return save_image(heatmap_path, image.sample_heatmap(), 1);
+		}
+
+		void render_tile(const tile& t, const hittable& world, framebuffer& image) const{
+			if(adaptive){
+				render_tile_adaptive(t, world, image);
+				return;
+			}
+			if(packet_size > 0){
+				render_tile_packets(t, world, image);
+				return;
+			}
+			if(tile_kernel){
+				(this->*tile_kernel)(t, world, image);
+				return;
+			}
+
+			for(int i=t.y0; i<t.y1; ++i){
+				for(int j=t.x0; j<t.x1; ++j){
+					thread_rng().seed(pixel_key(i, j));
+					color pixel_color(0,0,0);
+					for(int sample = 0; sample < samples_per_pixel; sample++){
+						thread_rng().set_sample(sample);
+						ray r = get_ray(j, i);
+						pixel_color += ray_color(r, world);
+					}
+					image.at(j, i) = pixel_color;
+				}
+			}
+		}
+
+		// Depths without a kernel of their own use the one for their lens that reads
+		// max_depth at run time.
+		kernel select_kernel() const{
+			if(max_depth <= 0)
+				return nullptr;
+			bool thin_lens = defocus_angle > 0;
+			switch(max_depth){
+				case 1: return thin_lens ? &camera::render_tile_kernel<true, 1> : &camera::render_tile_kernel<false, 1>;
+				case 2: return thin_lens ? &camera::render_tile_kernel<true, 2> : &camera::render_tile_kernel<false, 2>;
+				case 4: return thin_lens ? &camera::render_tile_kernel<true, 4> : &camera::render_tile_kernel<false, 4>;
+				case 8: return thin_lens ? &camera::render_tile_kernel<true, 8> : &camera::render_tile_kernel<false, 8>;
+				default: return thin_lens ? &camera::render_tile_kernel<true, 0> : &camera::render_tile_kernel<false, 0>;
+			}
+		}
+
+		// render_tile with the lens and, unless fixed_depth is 0, the depth known at compile
+		// time, so the camera ray has no lens branch and the bounces are unrolled.
+		template<bool thin_lens, int fixed_depth>
+		void render_tile_kernel(const tile& t, const hittable& world, framebuffer& image) const{
+			for(int i=t.y0; i<t.y1; ++i){
+				for(int j=t.x0; j<t.x1; ++j){
+					thread_rng().seed(pixel_key(i, j));
+					color pixel_color(0,0,0);
+					for(int sample = 0; sample < samples_per_pixel; sample++){
+						thread_rng().set_sample(sample);
+						ray r = lens_ray<thin_lens>(j, i);
+						hit_record rec;
+						bool hit = world.hit(r, interval(0.001, infinity), rec);
+						pixel_color += shade<fixed_depth>(r, hit, rec, world);
+					}
+					image.at(j, i) = pixel_color;
+				}
+			}
+		}
+
+		// Running mean and variance of a pixel's luminance (Welford's method).
+		struct pixel_estimate{
+			int n = 0;
+			real mean = 0, m2 = 0;
+
+			void add(const color& c){
+				real x = 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+				n++;
+				real delta = x - mean;
+				mean += delta / n;
+				m2 += delta * (x - mean);
+			}
+
+			// Standard error of the mean as seen on screen: the gamma curve (a square root)
+			// scales linear noise by 1 / (2 sqrt(mean)), so dark pixels need more samples
+			// than bright ones for the same visible noise.
+			real display_error() const{
+				if(n < 2)
+					return infinity;
+				return sqrt(m2 / (n - 1) / n) / (2 * sqrt(std::max(mean, real(0.001))));
+			}
+
+			// Expected drop in squared error from one more sample.
+			real gain() const{
+				real e = display_error();
+				return e * e / n;
+			}
+		};
+
+		void render_tile_adaptive(const tile& t, const hittable& world, framebuffer& image) const{
+			int tile_width = t.x1 - t.x0;
+			int n = tile_width * (t.y1 - t.y0);
+			long budget = static_cast<long>(n) * samples_per_pixel;
+			int first = (adaptive_min_samples > 0) ? adaptive_min_samples : samples_per_pixel / 2;
+			first = std::max(2, std::min(first, samples_per_pixel));
+			int batch = std::max(1, first / 2);
+			int most = 8 * samples_per_pixel;
+			std::vector<pixel_estimate> estimates(n);
+
+			// Samples keep their index within the pixel, so a pixel's first k samples are
+			// the same ones a uniform render would take.
+			auto take = [&](int k, int count){
+				int i = t.y0 + k / tile_width, j = t.x0 + k % tile_width;
+				thread_rng().seed(pixel_key(i, j));
+				for(int s = 0; s < count; s++){
+					thread_rng().set_sample(estimates[k].n);
+					color c = ray_color(get_ray(j, i), world);
+					image.at(j, i) += c;
+					estimates[k].add(c);
+				}
+				budget -= count;
+			};
+
+			for(int k = 0; k < n; k++)
+				take(k, first);
+
+			std::vector<int> noisy;
+			while(budget > 0){
+				noisy.clear();
+				for(int k = 0; k < n; k++)
+					if(estimates[k].n < most && estimates[k].display_error() > adaptive_threshold)
+						noisy.push_back(k);
+				if(noisy.empty())
+					break;
+
+				// Largest gain first, so a budget that runs out mid-round goes where it matters most.
+				std::sort(noisy.begin(), noisy.end(), [&](int a, int b){
+					return estimates[a].gain() > estimates[b].gain();
+				});
+				for(int k : noisy){
+					take(k, static_cast<int>(std::min<long>({batch, budget, most - estimates[k].n})));
+					if(budget <= 0)
+						break;
+				}
+			}
+
+			for(int k = 0; k < n; k++)
+				image.samples[static_cast<size_t>(t.y0 + k / tile_width) * width + t.x0 + k % tile_width] = estimates[k].n;
+		}
+
+		// Primary rays of a packet_size x packet_size block are traced together; each
+		// pixel's generator is repositioned before its ray is built and again before it is
+		// shaded, so the image matches the single-ray path.
+		void render_tile_packets(const tile& t, const hittable& world, framebuffer& image) const{
+			int side = std::min(packet_size, 8);
+			hit_record recs[ray_packet::max_size];
+
+			for(int by=t.y0; by<t.y1; by+=side){
+				for(int bx=t.x0; bx<t.x1; bx+=side){
+					int y1 = std::min(by + side, t.y1);
+					int x1 = std::min(bx + side, t.x1);
+
+					for(int sample = 0; sample < samples_per_pixel; sample++){
+						ray_packet packet;
+						for(int i=by; i<y1; ++i){
+							for(int j=bx; j<x1; ++j){
+								thread_rng().seed(pixel_key(i, j));
+								thread_rng().set_sample(sample);
+								packet.add(get_ray(j, i));
+							}
+						}
+
+						if(max_depth > 0)
+							world.hit_packet(packet, recs);
+
+						int k = 0;
+						for(int i=by; i<y1; ++i){
+							for(int j=bx; j<x1; ++j, ++k){
+								thread_rng().seed(pixel_key(i, j));
+								thread_rng().set_sample(sample);
+								image.at(j, i) += (max_depth > 0)
+									? shade(packet.rays[k], packet.hit[k], recs[k], world)
+									: color(0,0,0);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		void render_wavefront(const hittable& world, tile_scheduler& scheduler, framebuffer& image){
+			using clock = std::chrono::steady_clock;
+			const size_t chunk = 4096;
+			const uint64_t total = static_cast<uint64_t>(width) * height * samples_per_pixel;
+			uint64_t next = 0;
+
+			path_buffer paths;
+			paths.reserve(static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(wavefront_paths, total))));
+			material_sorter sorter;
+			std::vector<uint32_t> order;
+			wavefront_stats stats;
+
+			auto lap = [](clock::time_point& mark){
+				auto now = clock::now();
+				double seconds = std::chrono::duration<double>(now - mark).count();
+				mark = now;
+				return seconds;
+			};
+
+			while(next < total || paths.size > 0){
+				auto mark = clock::now();
+
+				// generate: fill the free slots with the next camera samples, pixel by pixel
+				size_t first = paths.size;
+				size_t count = static_cast<size_t>(std::min<uint64_t>(paths.capacity() - first, total - next));
+				parallel_chunks(scheduler, count, chunk, [&](size_t begin, size_t end){
+					for(size_t k=begin; k<end; ++k)
+						generate_path(paths, first + k, next + k);
+				});
+				paths.size += count;
+				next += count;
+				stats.paths += static_cast<long>(count);
+				stats.generate += lap(mark);
+
+				// extend: closest hit for every path
+				parallel_chunks(scheduler, paths.size, chunk, [&](size_t begin, size_t end){
+					for(size_t i=begin; i<end; ++i){
+						hit_record rec;
+						ray r = paths.get_ray(i);
+						paths.hit[i] = world.hit(r, interval(0.001, infinity), rec);
+						if(paths.hit[i]){
+							rec.fill_surface(r);
+							paths.set_hit(i, rec);
+						}
+					}
+				});
+				stats.rays += static_cast<long>(paths.size);
+				stats.extend += lap(mark);
+
+				// shade: scatter, grouped by material kind when sorting
+				if(wavefront_sort)
+					sorter.sort(paths, *scene_materials, order);
+				else
+					sorter.queue_order(paths, order);
+				parallel_chunks(scheduler, paths.size, chunk, [&](size_t begin, size_t end){
+					for(size_t k=begin; k<end; ++k)
+						shade_path(paths, order[k]);
+				});
+				stats.shade += lap(mark);
+
+				// connect: add finished paths to their pixels and compact the queue
+				size_t kept = 0;
+				for(size_t i=0; i<paths.size; ++i){
+					if(paths.done[i]){
+						int pixel = static_cast<int>(paths.pixel[i]);
+						image.at(pixel % width, pixel / width) += color(paths.radiance[0][i], paths.radiance[1][i], paths.radiance[2][i]);
+					}else{
+						paths.move(i, kept++);
+					}
+				}
+				paths.size = kept;
+				stats.connect += lap(mark);
+			}
+
+			last_wavefront_stats = stats;
+			stats.print(std::clog);
+		}
+
+		void generate_path(path_buffer& paths, size_t i, uint64_t index) const{
+			auto pixel = static_cast<uint32_t>(index / samples_per_pixel);
+			auto sample = static_cast<uint32_t>(index % samples_per_pixel);
+			int row = static_cast<int>(pixel / width), col = static_cast<int>(pixel % width);
+
+			thread_rng().seed(pixel_key(row, col));
+			thread_rng().set_sample(sample);
+			paths.set_ray(i, get_ray(col, row));
+			for(int a = 0; a < 3; a++)
+				paths.throughput[a][i] = 1;
+			paths.pixel[i] = pixel;
+			paths.sample[i] = sample;
+			paths.bounce[i] = 1;
+			paths.done[i] = 0;
+		}
+
+		void shade_path(path_buffer& paths, size_t i) const{
+			auto finish = [&](const color& radiance){
+				for(int a = 0; a < 3; a++)
+					paths.radiance[a][i] = paths.throughput[a][i] * radiance[a];
+				paths.done[i] = 1;
+			};
+
+			if(paths.bounce[i] > max_depth)
+				return finish(color(0,0,0));
+
+			ray r = paths.get_ray(i);
+			if(!paths.hit[i])
+				return finish(background(r));
+
+			int row = static_cast<int>(paths.pixel[i] / width), col = static_cast<int>(paths.pixel[i] % width);
+			thread_rng().seed(pixel_key(row, col));
+			thread_rng().set_sample(paths.sample[i]);
+			thread_rng().set_bounce(paths.bounce[i]);
+
+			hit_record rec = paths.get_hit(i);
+			ray scattered;
+			color attenuation;
+			if(!scene_materials->scatter(rec.material_id, r, rec, attenuation, scattered))
+				return finish(color(0,0,0));
+
+			color throughput(paths.throughput[0][i] * attenuation[0], paths.throughput[1][i] * attenuation[1], paths.throughput[2][i] * attenuation[2]);
+			if(paths.bounce[i] >= max_depth || !survives_roulette(throughput, paths.bounce[i]))
+				return finish(color(0,0,0));
+			for(int a = 0; a < 3; a++)
+				paths.throughput[a][i] = throughput[a];
+			paths.bounce[i]++;
+			paths.set_ray(i, scattered);
+		}
+
 		ray get_ray(int i, int j) const{
+			return (defocus_angle <= 0) ? lens_ray<false>(i, j) : lens_ray<true>(i, j);
+		}
+
+		template<bool thin_lens>
+		ray lens_ray(int i, int j) const{
 			auto pixel_center = pixel00_loc + (i * pixel_delta_u) + (j * pixel_delta_v);
 			auto pixel_sample = pixel_center + pixel_sample_square();
 
-			auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+			auto ray_origin = thin_lens ? defocus_disk_sample() : center;
 			auto ray_direction = pixel_sample - ray_origin;
 
 			return ray(ray_origin, ray_direction);
@@ -103,21 +637,83 @@ class camera{
 			return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
 		}
 		
-		color ray_color(const ray& r, int depth, const hittable& world) const{
+		color ray_color(const ray& r, const hittable& world) const{
 			hit_record rec;
 
-			if(depth<=0){
+			if(max_depth<=0){
 				return color(0,0,0);
 			}
 
-			if(world.hit(r, interval(0.001, infinity), rec)){
-				ray scattered;
-				color attenuation;
-				if(rec.mat->scatter(r, rec, attenuation, scattered))
-					return attenuation * ray_color(scattered, depth - 1, world);
+			bool hit = world.hit(r, interval(0.001, infinity), rec);
+			return shade(r, hit, rec, world);
+		}
+
+		// Follows the path from its first intersection, multiplying the attenuation of
+		// every bounce into a running throughput instead of recursing. Only the closest
+		// hit of each bounce gets its surface filled in. A fixed_depth other than 0 stands
+		// in for max_depth and unrolls the bounces through shade_bounce.
+		template<int fixed_depth = 0>
+		color shade(ray r, bool hit, hit_record rec, const hittable& world) const{
+			if constexpr(fixed_depth > 0){
+				return shade_bounce<1, fixed_depth>(r, hit, rec, world, color(1,1,1));
+			}else{
+				color throughput(1,1,1);
+				for(int bounce = 1; hit; bounce++){
+					thread_rng().set_bounce(bounce);
+					rec.fill_surface(r);
+					ray scattered;
+					color attenuation;
+					if(!scene_materials->scatter(rec.material_id, r, rec, attenuation, scattered))
+						return color(0,0,0);
+					throughput = throughput * attenuation;
+					if(bounce == max_depth || !survives_roulette(throughput, bounce))
+						return color(0,0,0);
+
+					r = scattered;
+					hit = world.hit(r, interval(0.001, infinity), rec);
+				}
+
+				return throughput * background(r);
+			}
+		}
+
+		// One bounce of shade's loop, instantiated once per bounce up to depth so the
+		// compiler sees straight-line code with no loop counter or depth test.
+		template<int bounce, int depth>
+		color shade_bounce(const ray& r, bool hit, hit_record& rec, const hittable& world, color throughput) const{
+			if(!hit)
+				return throughput * background(r);
+
+			thread_rng().set_bounce(bounce);
+			rec.fill_surface(r);
+			ray scattered;
+			color attenuation;
+			if(!scene_materials->scatter(rec.material_id, r, rec, attenuation, scattered))
 				return color(0,0,0);
+			throughput = throughput * attenuation;
+			if constexpr(bounce == depth){
+				return color(0,0,0);
+			}else{
+				if(!survives_roulette(throughput, bounce))
+					return color(0,0,0);
+				hit = world.hit(scattered, interval(0.001, infinity), rec);
+				return shade_bounce<bounce + 1, depth>(scattered, hit, rec, world, throughput);
 			}
+		}
+
+		// Russian roulette: from bounce roulette_depth on, a path continues with a probability
+		// equal to its largest throughput component and is reweighted to stay unbiased.
+		bool survives_roulette(color& throughput, int bounce) const{
+			if(roulette_depth <= 0 || bounce < roulette_depth)
+				return true;
+			real p = std::min<real>(0.95, std::max({throughput.x(), throughput.y(), throughput.z()}));
+			if(random_double() >= p)
+				return false;
+			throughput = throughput / p;
+			return true;
+		}
 
+		color background(const ray& r) const{
 			vec3 unit_direction = unit_vector(r.direction());
 			auto a = 0.5*(unit_direction.y() + 1.0);
 			return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0);
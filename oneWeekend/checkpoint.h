@@ -0,0 +1,133 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "rtweekend.h"
+
+#include "framebuffer.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Saved state of a progressive render: this header, then the accumulated radiance
+// (three reals per pixel), then the samples taken per pixel as uint32. The generators
+// are keyed by seed, pixel and sample index, so the seed and the per-pixel counts are
+// all the RNG state needed to continue exactly where a render stopped.
+struct checkpoint_header{
+	char magic[8];
+	uint32_t version;
+	uint32_t real_size;	// sizeof(real) in the build that wrote it
+	uint32_t width, height;
+	uint32_t samples_per_pixel;	// the render's target
+	uint32_t pad;
+	uint64_t seed;
+	uint64_t camera_key;	// hash of every camera setting that changes the image
+	char rng[16];
+	double seconds;	// render time spent up to this checkpoint, over all sessions
+
+	checkpoint_header(){
+		std::memset(this, 0, sizeof(*this));
+		std::memcpy(magic, "RTWCKPT", 8);
+		version = 1;
+		real_size = sizeof(real);
+		std::strncpy(rng, rng_name, sizeof(rng) - 1);
+	}
+
+	// Whether a checkpoint with this header can continue the render described by other.
+	bool matches(const checkpoint_header& other) const{
+		return std::memcmp(magic, other.magic, sizeof(magic)) == 0 && version == other.version
+			&& real_size == other.real_size && width == other.width && height == other.height
+			&& samples_per_pixel == other.samples_per_pixel && seed == other.seed
+			&& camera_key == other.camera_key && std::strncmp(rng, other.rng, sizeof(rng)) == 0;
+	}
+};
+
+static_assert(sizeof(color) == 3 * sizeof(real), "framebuffer pixels are copied as packed reals");
+
+inline size_t checkpoint_size(const framebuffer& image){
+	return sizeof(checkpoint_header) + image.pixels.size() * (sizeof(color) + sizeof(uint32_t));
+}
+
+inline void pack_checkpoint(const checkpoint_header& header, const framebuffer& image, unsigned char* out){
+	std::memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	std::memcpy(out, image.pixels.data(), image.pixels.size() * sizeof(color));
+	out += image.pixels.size() * sizeof(color);
+	for(int n : image.samples){
+		uint32_t count = static_cast<uint32_t>(n);
+		std::memcpy(out, &count, sizeof(count));
+		out += sizeof(count);
+	}
+}
+
+// Writes a temporary file and renames it over path, so an interruption mid-write
+// leaves the previous checkpoint intact.
+inline bool save_checkpoint(const std::string& path, const checkpoint_header& header, const framebuffer& image){
+	std::string temporary = path + ".tmp";
+	size_t size = checkpoint_size(image);
+
+	mapped_file file;
+	if(file.create(temporary, size)){
+		pack_checkpoint(header, image, file.data());
+		bool flushed = file.flush();
+		file.close();
+		if(!flushed)
+			return false;
+	}else{
+		std::vector<unsigned char> bytes(size);
+		pack_checkpoint(header, image, bytes.data());
+		std::ofstream out(temporary, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		if(!out)
+			return false;
+	}
+
+#if defined(_WIN32)
+	std::remove(path.c_str());
+#endif
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// Fills image (which must already have its size and a samples array) from the checkpoint
+// at path if it belongs to the render described by expected, and returns its header.
+inline bool load_checkpoint(const std::string& path, const checkpoint_header& expected, framebuffer& image, checkpoint_header& found){
+	mapped_file file;
+	std::vector<unsigned char> fallback;
+	const unsigned char* bytes = nullptr;
+	size_t size = 0;
+	if(file.open(path)){
+		bytes = file.data();
+		size = file.size();
+	}else{
+		std::ifstream in(path, std::ios::binary);
+		if(!in)
+			return false;
+		fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		bytes = fallback.data();
+		size = fallback.size();
+	}
+
+	if(size != checkpoint_size(image))
+		return false;
+	std::memcpy(&found, bytes, sizeof(found));
+	if(!found.matches(expected))
+		return false;
+
+	bytes += sizeof(found);
+	std::memcpy(image.pixels.data(), bytes, image.pixels.size() * sizeof(color));
+	bytes += image.pixels.size() * sizeof(color);
+	for(int& n : image.samples){
+		uint32_t count;
+		std::memcpy(&count, bytes, sizeof(count));
+		bytes += sizeof(count);
+		n = static_cast<int>(count);
+	}
+	return true;
+}
+
+#endif
@@ -3,33 +3,17 @@
 
 #include "vec3.h"
 
-#include <iostream>
-
 using color = vec3;
 
 inline double linear_to_gamma(double linear_component){
 	return sqrt(linear_component);
 }
 
-void write_color(std::ostream &out, color pixel_color, int samples_per_pixel){
-	auto r = pixel_color.x();
-	auto g = pixel_color.y();
-	auto b = pixel_color.z();
-
-	auto scale = 1.0/samples_per_pixel;
-	r *= scale;
-	g *= scale;
-	b *= scale;
-
-	r = linear_to_gamma(r);
-	g = linear_to_gamma(g);
-	b = linear_to_gamma(b);
-	
+// Maps one linear channel, already divided by the sample count, to an 8-bit display
+// value: gamma 2, clamped just below 1.
+inline unsigned char to_byte(real linear_component){
 	static const interval intensity(0.000, 0.999);
-	
-	out << static_cast<int>(256 * intensity.clamp(r)) << ' '
-		<< static_cast<int>(256 * intensity.clamp(g)) << ' '
-		<< static_cast<int>(256 * intensity.clamp(b)) << '\n';
+	return static_cast<unsigned char>(256 * intensity.clamp(linear_to_gamma(linear_component)));
 }
 
 #endif
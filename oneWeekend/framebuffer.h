@@ -0,0 +1,57 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "color.h"
+
+#include <vector>
+
+// Linear HDR radiance per pixel, summed over samples. Nothing is quantized until an
+// output format from image_writer.h encodes it. Adaptive renders also record how many
+// samples each pixel took; otherwise every pixel took the same samples_per_pixel.
+class framebuffer{
+	public:
+		int width, height;
+		std::vector<color> pixels;
+		std::vector<int> samples;	// per pixel, empty when uniform
+
+		framebuffer(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h) {}
+
+		color& at(int x, int y) { return pixels[static_cast<size_t>(y) * width + x]; }
+		const color& at(int x, int y) const { return pixels[static_cast<size_t>(y) * width + x]; }
+
+		// Mean radiance of pixel index.
+		color average(size_t index, int samples_per_pixel) const{
+			int n = samples.empty() ? samples_per_pixel : samples[index];
+			return pixels[index] * static_cast<real>(1.0 / (n > 0 ? n : 1));
+		}
+
+		long total_samples(int samples_per_pixel) const{
+			if(samples.empty())
+				return static_cast<long>(pixels.size()) * samples_per_pixel;
+			long total = 0;
+			for(int n : samples)
+				total += n;
+			return total;
+		}
+
+		// Samples taken per pixel as an image (black, red, yellow, white from fewest to
+		// most), to be written with one sample per pixel.
+		framebuffer sample_heatmap() const{
+			framebuffer heatmap(width, height);
+			int most = 1;
+			for(int n : samples)
+				most = (n > most) ? n : most;
+			for(size_t i=0; i<samples.size(); ++i){
+				real t = static_cast<real>(samples[i]) / most;
+				heatmap.pixels[i] = color(ramp(3*t), ramp(3*t - 1), ramp(3*t - 2));
+			}
+			return heatmap;
+		}
+
+	private:
+		static real ramp(real x){
+			return x < 0 ? 0 : (x > 1 ? 1 : x*x);
+		}
+};
+
+#endif
@@ -3,18 +3,32 @@
 
 #include "ray.h"
 
+#include "aabb.h"
+#include "ray_packet.h"
 #include "rtweekend.h"
 
-class material;
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 
+class hittable;
+
+// Intersection tests only record t, the object hit and its material id, since most
+// candidate hits are overtaken by a closer one. The surface point, normal and side are
+// filled in by fill_surface once the closest hit is known.
 class hit_record{
 	public:
+		real t;
+		const hittable* object;
+		uint32_t primitive;	// which of the object's primitives, for objects that hold many
+		uint32_t material_id;	// index into the scene's material_table
+
 		point3 p;
 		vec3 normal;
-		shared_ptr<material> mat;
-		double t;
 		bool front_face;
 
+		void fill_surface(const ray& r);
+
 		void set_face_normal(const ray& r, const vec3& outward_normal){
 			front_face = dot(r.direction(), outward_normal) < 0;
 			normal = front_face ? outward_normal : -outward_normal;
@@ -26,6 +40,33 @@ class hittable{
 		virtual ~hittable() = default;
 
 		virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+		virtual aabb bounding_box() const = 0;
+
+		// Computes rec.p, rec.normal and rec.front_face for a hit this object recorded.
+		// Containers pass their primitives' records through and never record themselves,
+		// so reaching this default means a primitive sets rec.object without overriding it.
+		// It aborts in every build rather than leave p and normal for scatter to read unset.
+		virtual void fill_surface(const ray&, hit_record&) const{
+			std::fputs("a hittable that records itself as rec.object must override fill_surface\n", stderr);
+			std::abort();
+		}
+
+		// Intersects every ray of the packet, tightening packet.t_max and setting
+		// packet.hit per ray. Acceleration structures override this to traverse once per
+		// packet; the default simply traces the rays one by one.
+		virtual void hit_packet(ray_packet& packet, hit_record* recs) const{
+			for(int i = 0; i < packet.size; i++){
+				if(hit(packet.rays[i], interval(packet.t_min, packet.t_max[i]), recs[i])){
+					packet.t_max[i] = recs[i].t;
+					packet.hit[i] = true;
+				}
+			}
+		}
 };
 
+inline void hit_record::fill_surface(const ray& r){
+	object->fill_surface(r, *this);
+}
+
 #endif
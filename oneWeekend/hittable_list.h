@@ -16,10 +16,14 @@ class hittable_list : public hittable{
 		hittable_list() {}
 		hittable_list(shared_ptr<hittable> object) { add(object); }
 
-		void clear() { objects.clear(); }
+		void clear(){
+			objects.clear();
+			bbox = aabb();
+		}
 
 		void add(shared_ptr<hittable> object){
 			objects.push_back(object);
+			bbox = aabb(bbox, object->bounding_box());
 		}
 
 		bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
@@ -36,6 +40,16 @@ class hittable_list : public hittable{
 			}
 			return hit_anything;
 		}
+
+		void hit_packet(ray_packet& packet, hit_record* recs) const override{
+			for(const auto& object : objects)
+				object->hit_packet(packet, recs);
+		}
+
+		aabb bounding_box() const override { return bbox; }
+
+	private:
+		aabb bbox;
 };
 
 #endif
@@ -0,0 +1,243 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "framebuffer.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Output formats for a finished framebuffer: binary 8-bit PPM (P6), linear 32-bit float
+// PFM, and 8-bit RGB PNG. Every encoder knows its exact size up front, so an image is
+// encoded straight into one buffer, or into a mapped file when it is large, and leaves
+// in a single write.
+enum class image_format{ ppm, pfm, png };
+
+// Picks the format from the file extension; anything unknown is written as PPM.
+inline image_format format_for(const std::string& path){
+	auto ends_with = [&](const char* ext){
+		size_t n = std::strlen(ext);
+		return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+	};
+	if(ends_with(".pfm")) return image_format::pfm;
+	if(ends_with(".png")) return image_format::png;
+	return image_format::ppm;
+}
+
+namespace image_detail{
+	inline std::string ppm_header(const framebuffer& image){
+		return "P6\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n255\n";
+	}
+
+	// A negative scale marks little-endian samples; the host's own order is written.
+	inline std::string pfm_header(const framebuffer& image){
+		const uint16_t probe = 1;
+		bool little = *reinterpret_cast<const unsigned char*>(&probe) == 1;
+		return "PF\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + (little ? "\n-1.0\n" : "\n1.0\n");
+	}
+
+	// The PNG pixel data is a zlib stream of uncompressed ("stored") deflate blocks, which
+	// needs no compressor and has a size known in advance.
+	const size_t stored_block = 65535;
+
+	inline size_t png_raw_size(const framebuffer& image){
+		return static_cast<size_t>(image.height) * (1 + 3 * static_cast<size_t>(image.width));
+	}
+
+	inline size_t png_zlib_size(const framebuffer& image){
+		size_t raw = png_raw_size(image);
+		size_t blocks = (raw + stored_block - 1) / stored_block;
+		return 2 + raw + 5 * blocks + 4;
+	}
+
+	struct crc_table{
+		uint32_t entries[256];
+
+		crc_table(){
+			for(uint32_t n = 0; n < 256; n++){
+				uint32_t c = n;
+				for(int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				entries[n] = c;
+			}
+		}
+	};
+
+	inline uint32_t crc32(const unsigned char* bytes, size_t n){
+		static const crc_table table_holder;
+		const uint32_t* table = table_holder.entries;
+		uint32_t c = 0xffffffffu;
+		for(size_t i = 0; i < n; i++)
+			c = table[(c ^ bytes[i]) & 0xff] ^ (c >> 8);
+		return c ^ 0xffffffffu;
+	}
+
+	inline unsigned char* put_u32(unsigned char* out, uint32_t v){
+		out[0] = static_cast<unsigned char>(v >> 24);
+		out[1] = static_cast<unsigned char>(v >> 16);
+		out[2] = static_cast<unsigned char>(v >> 8);
+		out[3] = static_cast<unsigned char>(v);
+		return out + 4;
+	}
+
+	// Writes one chunk whose data was already placed after the 8-byte length/type slot.
+	inline unsigned char* finish_chunk(unsigned char* chunk, const char* type, size_t length){
+		put_u32(chunk, static_cast<uint32_t>(length));
+		std::memcpy(chunk + 4, type, 4);
+		return put_u32(chunk + 8 + length, crc32(chunk + 4, length + 4));
+	}
+
+	// Streams the raw scanlines into stored blocks while keeping the Adler-32 checksum.
+	class stored_deflate{
+		public:
+			stored_deflate(unsigned char* out, size_t raw_size) : out(out), remaining(raw_size) {}
+
+			void put(unsigned char byte){
+				if(block_left == 0)
+					start_block();
+				*out++ = byte;
+				block_left--;
+				a += byte;
+				b += a;
+				if(++pending == 5552){	// largest run before the sums can overflow
+					a %= 65521;
+					b %= 65521;
+					pending = 0;
+				}
+			}
+
+			unsigned char* finish(){
+				a %= 65521;
+				b %= 65521;
+				return put_u32(out, (b << 16) | a);
+			}
+
+		private:
+			unsigned char* out;
+			size_t remaining;
+			size_t block_left = 0;
+			uint32_t a = 1, b = 0;
+			int pending = 0;
+
+			void start_block(){
+				size_t n = remaining < stored_block ? remaining : stored_block;
+				remaining -= n;
+				block_left = n;
+				*out++ = (remaining == 0) ? 1 : 0;
+				*out++ = static_cast<unsigned char>(n);
+				*out++ = static_cast<unsigned char>(n >> 8);
+				*out++ = static_cast<unsigned char>(~n);
+				*out++ = static_cast<unsigned char>(~n >> 8);
+			}
+	};
+}
+
+inline size_t encoded_size(const framebuffer& image, image_format format){
+	size_t pixels = static_cast<size_t>(image.width) * image.height;
+	switch(format){
+		case image_format::pfm: return image_detail::pfm_header(image).size() + pixels * 3 * sizeof(float);
+		case image_format::png: return 8 + (12 + 13) + (12 + image_detail::png_zlib_size(image)) + 12;
+		default: return image_detail::ppm_header(image).size() + pixels * 3;
+	}
+}
+
+// Encodes the image into out, which must hold encoded_size(image, format) bytes.
+inline void encode_image(const framebuffer& image, int samples_per_pixel, image_format format, unsigned char* out){
+	using namespace image_detail;
+	if(format == image_format::pfm){
+		std::string header = pfm_header(image);
+		std::memcpy(out, header.data(), header.size());
+		out += header.size();
+		// PFM stores the bottom row first.
+		for(int y = image.height - 1; y >= 0; y--){
+			for(int x = 0; x < image.width; x++){
+				color c = image.average(static_cast<size_t>(y) * image.width + x, samples_per_pixel);
+				float rgb[3] = {static_cast<float>(c.x()), static_cast<float>(c.y()), static_cast<float>(c.z())};
+				std::memcpy(out, rgb, sizeof(rgb));
+				out += sizeof(rgb);
+			}
+		}
+		return;
+	}
+
+	if(format == image_format::png){
+		static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		std::memcpy(out, signature, 8);
+		out += 8;
+
+		unsigned char* ihdr = out;
+		unsigned char* data = put_u32(ihdr + 8, static_cast<uint32_t>(image.width));
+		data = put_u32(data, static_cast<uint32_t>(image.height));
+		const unsigned char rest[5] = {8, 2, 0, 0, 0};	// 8-bit RGB, no interlace
+		std::memcpy(data, rest, 5);
+		out = finish_chunk(ihdr, "IHDR", 13);
+
+		unsigned char* idat = out;
+		unsigned char* z = idat + 8;
+		*z++ = 0x78;
+		*z++ = 0x01;
+		stored_deflate deflate(z, png_raw_size(image));
+		for(int y = 0; y < image.height; y++){
+			deflate.put(0);	// no scanline filter
+			for(int x = 0; x < image.width; x++){
+				color c = image.average(static_cast<size_t>(y) * image.width + x, samples_per_pixel);
+				deflate.put(to_byte(c.x()));
+				deflate.put(to_byte(c.y()));
+				deflate.put(to_byte(c.z()));
+			}
+		}
+		deflate.finish();
+		out = finish_chunk(idat, "IDAT", png_zlib_size(image));
+
+		finish_chunk(out, "IEND", 0);
+		return;
+	}
+
+	std::string header = ppm_header(image);
+	std::memcpy(out, header.data(), header.size());
+	out += header.size();
+	for(size_t i=0; i<image.pixels.size(); ++i){
+		color c = image.average(i, samples_per_pixel);
+		*out++ = to_byte(c.x());
+		*out++ = to_byte(c.y());
+		*out++ = to_byte(c.z());
+	}
+}
+
+// Encodes into memory and hands the stream the whole image in one write.
+inline bool write_image(std::ostream& out, const framebuffer& image, int samples_per_pixel, image_format format){
+	std::vector<unsigned char> bytes(encoded_size(image, format));
+	encode_image(image, samples_per_pixel, format, bytes.data());
+	out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+	out.flush();
+	return static_cast<bool>(out);
+}
+
+// Images of at least this many bytes are encoded directly into a mapped file.
+const size_t mapped_output_threshold = size_t(16) << 20;
+
+// Saves in the format named by the extension of path.
+inline bool save_image(const std::string& path, const framebuffer& image, int samples_per_pixel){
+	image_format format = format_for(path);
+	size_t size = encoded_size(image, format);
+
+	if(size >= mapped_output_threshold){
+		mapped_file file;
+		if(file.create(path, size)){
+			encode_image(image, samples_per_pixel, format, file.data());
+			return file.flush();
+		}
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	return out && write_image(out, image, samples_per_pixel, format);
+}
+
+#endif
@@ -0,0 +1,109 @@
+// Compares two renders of the same scene and reports how far apart they are.
+// Build: g++ -std=c++17 -O2 imgdiff.cpp -o imgdiff
+// Run:   ./imgdiff a.ppm b.ppm [min_psnr]   (exits with 1 when the PSNR is below min_psnr)
+//
+// Typical use is checking a single precision build against the default one:
+//   g++ -std=c++17 -O2 -pthread rtow.cpp -o rtow && ./rtow > double.ppm
+//   g++ -std=c++17 -O2 -pthread -D RTW_FLOAT rtow.cpp -o rtow_float && ./rtow_float > float.ppm
+//   ./imgdiff double.ppm float.ppm
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct image{
+	int width = 0, height = 0;
+	std::vector<int> values;	// r, g, b per pixel, 0-255
+};
+
+// Skips whitespace and '#' comments between header fields.
+static void skip_space(std::istream& in){
+	while(true){
+		int c = in.peek();
+		if(c == '#'){
+			std::string comment;
+			std::getline(in, comment);
+		}else if(std::isspace(c)){
+			in.get();
+		}else{
+			return;
+		}
+	}
+}
+
+// Reads a plain (P3) or binary (P6) PPM with a maximum value of 255.
+static bool read_ppm(const char* path, image& img){
+	std::ifstream in(path, std::ios::binary);
+	std::string magic;
+	int max_value = 0;
+	in >> magic;
+	skip_space(in);
+	in >> img.width;
+	skip_space(in);
+	in >> img.height;
+	skip_space(in);
+	in >> max_value;
+	if(!in || (magic != "P3" && magic != "P6") || max_value != 255 || img.width <= 0 || img.height <= 0){
+		std::cerr << path << ": not an 8-bit PPM\n";
+		return false;
+	}
+
+	img.values.resize(static_cast<size_t>(img.width) * img.height * 3);
+	if(magic == "P6"){
+		in.get();
+		std::vector<unsigned char> bytes(img.values.size());
+		in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		for(size_t i=0; i<bytes.size(); ++i)
+			img.values[i] = bytes[i];
+	}else{
+		for(int& v : img.values)
+			in >> v;
+	}
+	if(!in){
+		std::cerr << path << ": truncated image\n";
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv){
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0] << " a.ppm b.ppm [min_psnr]\n";
+		return 2;
+	}
+
+	image a, b;
+	if(!read_ppm(argv[1], a) || !read_ppm(argv[2], b))
+		return 2;
+	if(a.width != b.width || a.height != b.height){
+		std::cerr << "images differ in size: " << a.width << 'x' << a.height << " vs " << b.width << 'x' << b.height << '\n';
+		return 2;
+	}
+
+	double squared_error = 0;
+	int max_error = 0;
+	size_t pixels_differing = 0;
+	for(size_t p=0; p<a.values.size(); p+=3){
+		bool differs = false;
+		for(size_t c=p; c<p+3; ++c){
+			int e = std::abs(a.values[c] - b.values[c]);
+			squared_error += static_cast<double>(e) * e;
+			max_error = (e > max_error) ? e : max_error;
+			differs = differs || e != 0;
+		}
+		pixels_differing += differs;
+	}
+
+	double mse = squared_error / a.values.size();
+	double psnr = (mse > 0) ? 10 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+	std::cout << "MSE " << mse << ", PSNR " << psnr << " dB, max channel error " << max_error
+		<< ", " << pixels_differing << " of " << a.values.size() / 3 << " pixels differ\n";
+
+	if(argc > 3 && psnr < std::atof(argv[3]))
+		return 1;
+	return 0;
+}
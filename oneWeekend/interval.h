@@ -1,31 +1,46 @@
 #ifndef INTERVAL_H
 #define INTERVAL_H
 
-class interval{
+template<typename T>
+class interval_t{
 	public:
-		double max, min;
+		T max, min;
 
-		interval() : min(+infinity), max(-infinity) {}
+		interval_t() : min(+infinity), max(-infinity) {}
 
-		interval(double _min, double _max) : min(_min), max(_max) {}
+		interval_t(T _min, T _max) : min(_min), max(_max) {}
 
-		bool contains(double x) const{
+		interval_t(const interval_t& a, const interval_t& b)
+			: min(fmin(a.min, b.min)), max(fmax(a.max, b.max)) {}
+
+		T size() const{
+			return max - min;
+		}
+
+		interval_t expand(T delta) const{
+			auto padding = delta/2;
+			return interval_t(min - padding, max + padding);
+		}
+
+		bool contains(T x) const{
 			return min <= x && x <= max;
 		}
 
-		bool surrounds(double x) const{
+		bool surrounds(T x) const{
 			return min < x && x < max;
 		}
 
-		double clamp(double x) const{
+		T clamp(T x) const{
 			if(x < min) return min;
 			if(x > max) return max;
 			return x;
 		}
 		
-		static const interval empty, universe;
+		static const interval_t empty, universe;
 };
 
+using interval = interval_t<real>;
+
 const static interval empty(+infinity, -infinity);
 const static interval universe(-infinity, +infinity);
 
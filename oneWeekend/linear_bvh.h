@@ -0,0 +1,231 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "hittable.h"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// One node of the flattened tree. Nodes are stored depth first, so the first child of
+// an interior node is always the next node and only the second child needs an offset.
+struct linear_bvh_node{
+	float bounds_min[3];
+	float bounds_max[3];
+	uint32_t offset;	// leaf: first primitive, interior: index of the second child
+	uint16_t count;		// primitives in a leaf, 0 for interior nodes
+	uint8_t axis;
+	uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node should fill half a cache line");
+
+// A bvh_node tree compiled into one contiguous array and traversed with a small
+// explicit stack, so a ray never chases shared_ptrs between nodes. Subtrees with at
+// most max_leaf_size primitives collapse into a single leaf.
+class linear_bvh : public hittable{
+	public:
+		static const int max_leaf_size = 4;
+		// Traversal pushes at most one node per level; bvh_node caps its depth to fit.
+		static const int stack_capacity = 64;
+
+		linear_bvh(const hittable_list& list) : linear_bvh(bvh_node(list)) {}
+
+		linear_bvh(const bvh_node& tree){
+			if(tree.left)
+				flatten(tree, 0);
+			assert(tree_depth <= stack_capacity);
+			bbox = tree.bounding_box();
+		}
+
+		bool hit(const ray& r, interval ray_t, hit_record& rec) const override{
+			if(nodes.empty())
+				return false;
+			bool reversed[3] = {r.direction().x() < 0, r.direction().y() < 0, r.direction().z() < 0};
+			bool hit_anything = false;
+
+			uint32_t stack[stack_capacity];
+			int stack_size = 0;
+			uint32_t current = 0;
+
+			while(true){
+				const linear_bvh_node& node = nodes[current];
+				if(box_hit(node, r, ray_t)){
+					if(node.count > 0){
+						for(uint32_t i = node.offset; i < node.offset + node.count; ++i){
+							if(primitives[i]->hit(r, ray_t, rec)){
+								hit_anything = true;
+								ray_t.max = rec.t;
+							}
+						}
+					}else if(reversed[node.axis]){
+						stack[stack_size++] = current + 1;
+						current = node.offset;
+						continue;
+					}else{
+						stack[stack_size++] = node.offset;
+						current = current + 1;
+						continue;
+					}
+				}
+				if(stack_size == 0)
+					break;
+				current = stack[--stack_size];
+			}
+
+			return hit_anything;
+		}
+
+		// Packet traversal: a node is culled for the whole packet by its frustum bounds, and
+		// otherwise every ray is slab-tested at once; leaves only test the rays that entered.
+		void hit_packet(ray_packet& packet, hit_record* recs) const override{
+			if(nodes.empty())
+				return;
+			if(!packet.coherent){
+				hittable::hit_packet(packet, recs);
+				return;
+			}
+
+			bool mask[ray_packet::max_size];
+			real t_far = packet.farthest();
+
+			uint32_t stack[stack_capacity];
+			int stack_size = 0;
+			uint32_t current = 0;
+
+			while(true){
+				const linear_bvh_node& node = nodes[current];
+				real bmin[3] = {node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]};
+				real bmax[3] = {node.bounds_max[0], node.bounds_max[1], node.bounds_max[2]};
+
+				if(packet.may_hit(bmin, bmax, t_far) && packet.box_hits(bmin, bmax, mask)){
+					if(node.count > 0){
+						for(uint32_t p = node.offset; p < node.offset + node.count; ++p){
+							for(int i = 0; i < packet.size; i++){
+								if(mask[i] && primitives[p]->hit(packet.rays[i], interval(packet.t_min, packet.t_max[i]), recs[i])){
+									packet.t_max[i] = recs[i].t;
+									packet.hit[i] = true;
+								}
+							}
+						}
+						t_far = packet.farthest();
+					}else if(packet.direction_negative(node.axis)){
+						stack[stack_size++] = current + 1;
+						current = node.offset;
+						continue;
+					}else{
+						stack[stack_size++] = node.offset;
+						current = current + 1;
+						continue;
+					}
+				}
+				if(stack_size == 0)
+					break;
+				current = stack[--stack_size];
+			}
+		}
+
+		aabb bounding_box() const override { return bbox; }
+
+		size_t node_count() const { return nodes.size(); }
+		// Interior nodes on the longest path from the root, the most a traversal pushes.
+		int depth() const { return tree_depth; }
+
+	private:
+		std::vector<linear_bvh_node> nodes;
+		std::vector<const hittable*> primitives;
+		std::vector<shared_ptr<hittable>> owned;
+		aabb bbox;
+		int tree_depth = 0;
+
+		static bool box_hit(const linear_bvh_node& node, const ray& r, interval ray_t){
+			const point3& orig = r.origin();
+			const vec3& inv = r.inverse_direction();
+			for(int a = 0; a < 3; a++){
+				auto t0 = (node.bounds_min[a] - orig[a]) * inv[a];
+				auto t1 = (node.bounds_max[a] - orig[a]) * inv[a];
+				if(inv[a] < 0)
+					std::swap(t0, t1);
+
+				if(t0 > ray_t.min) ray_t.min = t0;
+				if(t1 < ray_t.max) ray_t.max = t1;
+				if(ray_t.max <= ray_t.min)
+					return false;
+			}
+			return true;
+		}
+
+		static const bvh_node* as_node(const shared_ptr<hittable>& child){
+			return dynamic_cast<const bvh_node*>(child.get());
+		}
+
+		static size_t leaf_count(const shared_ptr<hittable>& child, size_t limit){
+			const bvh_node* inner = as_node(child);
+			if(!inner)
+				return 1;
+			size_t n = leaf_count(inner->left, limit);
+			if(n > limit || inner->left == inner->right)
+				return n;
+			return n + leaf_count(inner->right, limit - n);
+		}
+
+		void collect(const shared_ptr<hittable>& child){
+			const bvh_node* inner = as_node(child);
+			if(!inner){
+				owned.push_back(child);
+				primitives.push_back(child.get());
+				return;
+			}
+			collect(inner->left);
+			if(inner->right != inner->left)
+				collect(inner->right);
+		}
+
+		// Bounds are rounded outwards to float so a node never clips a primitive it holds.
+		uint32_t push_node(const aabb& box){
+			linear_bvh_node node = {};
+			for(int a = 0; a < 3; a++){
+				node.bounds_min[a] = std::nextafter(static_cast<float>(box.axis(a).min), -std::numeric_limits<float>::infinity());
+				node.bounds_max[a] = std::nextafter(static_cast<float>(box.axis(a).max), std::numeric_limits<float>::infinity());
+			}
+			nodes.push_back(node);
+			return static_cast<uint32_t>(nodes.size() - 1);
+		}
+
+		void flatten(const bvh_node& tree, int depth){
+			uint32_t index = push_node(tree.bounding_box());
+			bool single = (tree.left == tree.right);
+			size_t count = single ? leaf_count(tree.left, max_leaf_size) : leaf_count(tree.left, max_leaf_size) + leaf_count(tree.right, max_leaf_size);
+
+			if(count <= max_leaf_size){
+				nodes[index].offset = static_cast<uint32_t>(primitives.size());
+				collect(tree.left);
+				if(!single)
+					collect(tree.right);
+				nodes[index].count = static_cast<uint16_t>(primitives.size() - nodes[index].offset);
+				return;
+			}
+
+			tree_depth = std::max(tree_depth, depth + 1);
+			nodes[index].axis = static_cast<uint8_t>(tree.axis);
+			flatten_child(tree.left, depth + 1);
+			nodes[index].offset = static_cast<uint32_t>(nodes.size());
+			flatten_child(tree.right, depth + 1);
+		}
+
+		void flatten_child(const shared_ptr<hittable>& child, int depth){
+			if(const bvh_node* inner = as_node(child)){
+				flatten(*inner, depth);
+				return;
+			}
+			uint32_t index = push_node(child->bounding_box());
+			nodes[index].offset = static_cast<uint32_t>(primitives.size());
+			nodes[index].count = 1;
+			collect(child);
+		}
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define RTW_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// A whole file mapped into memory. On platforms without mmap every call fails and
+// returns false, and callers fall back to ordinary stream I/O.
+class mapped_file{
+	public:
+		mapped_file() {}
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		~mapped_file() { close(); }
+
+		static bool supported(){
+#if defined(RTW_HAS_MMAP)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		// Creates path, or truncates it, with exactly size bytes and maps it writable. The
+		// blocks are allocated up front, so a full disk fails here, where the caller can
+		// fall back to stream I/O, instead of raising SIGBUS while the mapping is written.
+		bool create(const std::string& path, size_t size){
+			close();
+#if defined(RTW_HAS_MMAP)
+			int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if(fd < 0)
+				return false;
+			if(size == 0 || !reserve(fd, size)){
+				::close(fd);
+				return false;
+			}
+			return map(fd, size, true);
+#else
+			(void)path; (void)size;
+			return false;
+#endif
+		}
+
+		// Maps an existing file, read-only unless writable is set.
+		bool open(const std::string& path, bool writable = false){
+			close();
+#if defined(RTW_HAS_MMAP)
+			int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+			if(fd < 0)
+				return false;
+			struct stat info;
+			if(fstat(fd, &info) != 0 || info.st_size <= 0){
+				::close(fd);
+				return false;
+			}
+			return map(fd, static_cast<size_t>(info.st_size), writable);
+#else
+			(void)path; (void)writable;
+			return false;
+#endif
+		}
+
+		// Writes dirty pages back to the file before returning.
+		bool flush(){
+#if defined(RTW_HAS_MMAP)
+			return bytes && msync(bytes, length, MS_SYNC) == 0;
+#else
+			return false;
+#endif
+		}
+
+		void close(){
+#if defined(RTW_HAS_MMAP)
+			if(bytes)
+				munmap(bytes, length);
+#endif
+			bytes = nullptr;
+			length = 0;
+		}
+
+		bool is_open() const { return bytes != nullptr; }
+		unsigned char* data() { return bytes; }
+		const unsigned char* data() const { return bytes; }
+		size_t size() const { return length; }
+
+	private:
+		unsigned char* bytes = nullptr;
+		size_t length = 0;
+
+#if defined(RTW_HAS_MMAP)
+		// Grows the file to size bytes with every block allocated, unlike a sparse ftruncate.
+		static bool reserve(int fd, size_t size){
+	#if defined(__APPLE__)
+			fstore_t store = {F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(size), 0};
+			if(fcntl(fd, F_PREALLOCATE, &store) == -1)
+				return false;
+			return ftruncate(fd, static_cast<off_t>(size)) == 0;
+	#else
+			return posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+	#endif
+		}
+
+		// The descriptor is closed right away; the mapping keeps the file alive.
+		bool map(int fd, size_t size, bool writable){
+			int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+			void* p = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+			::close(fd);
+			if(p == MAP_FAILED)
+				return false;
+			bytes = static_cast<unsigned char*>(p);
+			length = size;
+			return true;
+		}
+#endif
+};
+
+#endif
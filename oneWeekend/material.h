@@ -3,8 +3,15 @@
 
 #include "rtweekend.h"
 
+#include <cstdint>
+#include <variant>
+#include <vector>
+
 class hit_record;
 
+// The interface of every material. The tracer itself only sees the closed set below,
+// through material_table, which calls scatter on the concrete type without a virtual
+// call; the classes are final so that call can be inlined.
 class material{
 	public:
 		virtual ~material() = default;
@@ -13,7 +20,7 @@ class material{
 				const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
 };
 
-class lambertian : public material{
+class lambertian final : public material{
 	public:
 		lambertian(const color& a) : albedo(a) {}
 
@@ -32,9 +39,9 @@ class lambertian : public material{
 		color albedo;
 };
 
-class metal : public material{
+class metal final : public material{
 	public:
-		metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+		metal(const color& a, real f) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
 		bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override{
 			vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
@@ -45,20 +52,20 @@ class metal : public material{
 
 	private:
 		color albedo;
-		double fuzz;
+		real fuzz;
 };
 
-class dielectric : public material{
+class dielectric final : public material{
 	public:
-		dielectric(double index_of_refraction) : ir(index_of_refraction) {}
+		dielectric(real index_of_refraction) : ir(index_of_refraction) {}
 
 		bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override{
 			attenuation = color(1.0,1.0,1.0);
-			double refraction_ratio = rec.front_face ? (1.0/ir) : ir;
+			real refraction_ratio = rec.front_face ? (1.0/ir) : ir;
 
 			vec3 unit_direction = unit_vector(r_in.direction());
-			double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-			double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+			real cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
+			real sin_theta = sqrt(1.0 - cos_theta * cos_theta);
 
 			bool cannot_refract = refraction_ratio * sin_theta > 1.0;
 			vec3 direction;
@@ -73,13 +80,41 @@ class dielectric : public material{
 		}
 
 	private:
-		double ir;
+		real ir;
 
-		static double reflectance(double cosine, double ref_idx){
+		static real reflectance(real cosine, real ref_idx){
 			auto r0 = (1-ref_idx) / (1+ref_idx);
 			r0 = r0*r0;
 			return r0 + (1-r0)*pow((1-cosine),5);
 		}
 };
 
+// Any material the tracer can render, stored by value. Its index is the material's
+// kind, which the wavefront renderer sorts hits by.
+using any_material = std::variant<lambertian, metal, dielectric>;
+
+const uint32_t material_kinds = std::variant_size<any_material>::value;
+
+// The materials of a scene, addressed by the 32-bit ids that spheres and hit records
+// carry. Objects refer to a material by id alone, so recording a hit copies an integer
+// instead of touching a shared reference count, and scatter dispatches on the variant's
+// type tag rather than through a virtual call.
+class material_table{
+	public:
+		uint32_t add(const any_material& mat){
+			materials.push_back(mat);
+			return static_cast<uint32_t>(materials.size() - 1);
+		}
+
+		bool scatter(uint32_t id, const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const{
+			return std::visit([&](const auto& mat){ return mat.scatter(r_in, rec, attenuation, scattered); }, materials[id]);
+		}
+
+		uint32_t kind(uint32_t id) const { return static_cast<uint32_t>(materials[id].index()); }
+		size_t size() const { return materials.size(); }
+
+	private:
+		std::vector<any_material> materials;
+};
+
 #endif
@@ -0,0 +1,161 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <cstdlib>
+
+// Random number generators for the tracer. They all have the same interface:
+//   seed(key)          restart the generator for one pixel
+//   set_sample(sample) position it at the start of a sample
+//   set_bounce(bounce) position it at a bounce of the current sample
+//   next_double()      uniform double in [0,1)
+// Every bounce of every sample of every pixel is therefore reproducible on its own.
+// The stateful generators (pcg32, xoshiro256plus) do this by reseeding from the
+// position, which costs a few multiplies per call; the counter-based squares generator
+// derives every number directly from (key, sample, bounce, draw).
+
+inline uint64_t mix_bits(uint64_t z){
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+inline uint64_t stream_seed(uint64_t key, uint64_t sample, uint64_t bounce){
+	return key ^ mix_bits((sample << 12 | bounce) + 0x9e3779b97f4a7c15ULL);
+}
+
+class pcg32{
+	public:
+		void seed(uint64_t k){
+			key = k;
+			state = 0;
+			inc = (mix_bits(key) << 1) | 1;
+			next_u32();
+			state += mix_bits(key ^ 0x853c49e6748fea9bULL);
+			next_u32();
+		}
+
+		void set_sample(uint64_t s){
+			sample = s;
+			set_bounce(0);
+		}
+
+		void set_bounce(uint64_t bounce){
+			state = mix_bits(stream_seed(key, sample, bounce));
+			next_u32();
+		}
+
+		uint32_t next_u32(){
+			uint64_t old = state;
+			state = old * 6364136223846793005ULL + inc;
+			uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+			uint32_t rot = static_cast<uint32_t>(old >> 59);
+			return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+		}
+
+		double next_double(){
+			return next_u32() * 0x1.0p-32;
+		}
+
+	private:
+		uint64_t key = 0;
+		uint64_t sample = 0;
+		uint64_t state = 0x853c49e6748fea9bULL;
+		uint64_t inc = 0xda3e39cb94b95bdbULL;
+};
+
+class xoshiro256plus{
+	public:
+		void seed(uint64_t k){
+			key = k;
+			set_sample(0);
+		}
+
+		void set_sample(uint64_t s){
+			sample = s;
+			set_bounce(0);
+		}
+
+		void set_bounce(uint64_t bounce){
+			uint64_t z = stream_seed(key, sample, bounce);
+			for(auto& word : state)
+				word = mix_bits(z += 0x9e3779b97f4a7c15ULL);
+		}
+
+		uint64_t next_u64(){
+			uint64_t* s = state;
+			uint64_t result = s[0] + s[3];
+			uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = (s[3] << 45) | (s[3] >> 19);
+			return result;
+		}
+
+		double next_double(){
+			return (next_u64() >> 11) * 0x1.0p-53;
+		}
+
+	private:
+		uint64_t key = 0;
+		uint64_t sample = 0;
+		uint64_t state[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+};
+
+// Widynski's "Squares" counter-based generator. The counter is laid out as
+// sample (32 bits) | bounce (12 bits) | draw within the bounce (20 bits).
+class squares{
+	public:
+		void seed(uint64_t k){
+			key = mix_bits(k) | 1;
+			sample = 0;
+			counter = 0;
+		}
+
+		void set_sample(uint64_t s){
+			sample = s;
+			counter = sample << 32;
+		}
+
+		void set_bounce(uint64_t bounce){
+			counter = (sample << 32) | ((bounce & 0xfff) << 20);
+		}
+
+		uint64_t next_u64(){
+			uint64_t t, x, y, z;
+			y = x = counter++ * key;
+			z = y + key;
+			x = x*x + y; x = (x >> 32) | (x << 32);
+			x = x*x + z; x = (x >> 32) | (x << 32);
+			x = x*x + y; x = (x >> 32) | (x << 32);
+			t = x = x*x + z; x = (x >> 32) | (x << 32);
+			return t ^ ((x*x + y) >> 32);
+		}
+
+		double next_double(){
+			return (next_u64() >> 11) * 0x1.0p-53;
+		}
+
+	private:
+		uint64_t key = 0x548c9decbce65297ULL;
+		uint64_t sample = 0;
+		uint64_t counter = 0;
+};
+
+// The original C library path, kept for benchmarking. rand() shares one global
+// state, so images rendered with it depend on thread timing.
+class c_rand{
+	public:
+		void seed(uint64_t) {}
+		void set_sample(uint64_t) {}
+		void set_bounce(uint64_t) {}
+
+		double next_double(){
+			return rand() / (RAND_MAX + 1.0);
+		}
+};
+
+#endif
@@ -3,22 +3,29 @@
 
 #include "vec3.h"
 
-class ray {
+template<typename T>
+class ray_t {
 	public:
-		ray() {}
+		ray_t() {}
 
-		ray(const point3& origin, const vec3& direction) : orig(origin) , dir(direction) {}
+		ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction)
+			: orig(origin) , dir(direction), inv_dir(1/direction.x(), 1/direction.y(), 1/direction.z()) {}
 
-		point3 origin() const { return orig; }
-		vec3 direction() const { return dir; }
+		vec3_t<T> origin() const { return orig; }
+		vec3_t<T> direction() const { return dir; }
+		// Per-axis reciprocal of the direction, used by the slab test against bounding boxes
+		const vec3_t<T>& inverse_direction() const { return inv_dir; }
 
-		point3 at(double t) const {
+		vec3_t<T> at(T t) const {
 			return orig + t*dir;
 		}
 
 	private:
-		point3 orig;
-		vec3 dir;
+		vec3_t<T> orig;
+		vec3_t<T> dir;
+		vec3_t<T> inv_dir;
 };
 
+using ray = ray_t<real>;
+
 #endif
@@ -0,0 +1,110 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+
+// A group of up to 64 rays traced together. Besides the rays themselves the packet keeps
+// their origins and inverse directions as separate arrays for batched slab tests, and the
+// per-axis bounds of both, which let a whole packet be culled against a box at once
+// (interval arithmetic over the packet's frustum).
+class ray_packet{
+	public:
+		static const int max_size = 64;
+
+		int size = 0;
+		ray rays[max_size];
+		real t_min = 0.001;
+		real t_max[max_size];	// closest hit so far, per ray
+		bool hit[max_size];
+
+		real origin[3][max_size];
+		real inv_dir[3][max_size];
+		interval origin_bounds[3];
+		interval inv_dir_bounds[3];
+		bool coherent = true;	// every ray has the same direction signs
+
+		void add(const ray& r){
+			int i = size++;
+			rays[i] = r;
+			t_max[i] = infinity;
+			hit[i] = false;
+			for(int a = 0; a < 3; a++){
+				origin[a][i] = r.origin()[a];
+				inv_dir[a][i] = r.inverse_direction()[a];
+				origin_bounds[a] = interval(origin_bounds[a], interval(origin[a][i], origin[a][i]));
+				inv_dir_bounds[a] = interval(inv_dir_bounds[a], interval(inv_dir[a][i], inv_dir[a][i]));
+			}
+			coherent = coherent && same_signs(r);
+		}
+
+		real farthest() const{
+			return *std::max_element(t_max, t_max + size);
+		}
+
+		bool direction_negative(int axis) const{
+			return inv_dir_bounds[axis].max < 0;
+		}
+
+		// Conservative test of the whole packet against a box: false only if no ray can
+		// enter it before its closest hit. Only valid for coherent packets.
+		bool may_hit(const real bmin[3], const real bmax[3], real t_far) const{
+			real enter = t_min;
+			real leave = t_far;
+			for(int a = 0; a < 3; a++){
+				real near_plane = direction_negative(a) ? bmax[a] : bmin[a];
+				real far_plane = direction_negative(a) ? bmin[a] : bmax[a];
+				interval near_offset(near_plane - origin_bounds[a].max, near_plane - origin_bounds[a].min);
+				interval far_offset(far_plane - origin_bounds[a].max, far_plane - origin_bounds[a].min);
+				enter = std::max(enter, product(near_offset, inv_dir_bounds[a]).min);
+				leave = std::min(leave, product(far_offset, inv_dir_bounds[a]).max);
+				if(leave < enter)
+					return false;
+			}
+			return true;
+		}
+
+		// Per-ray slab test written as straight loops over the packet arrays so the
+		// compiler can vectorize it. Returns whether any ray hit.
+		bool box_hits(const real bmin[3], const real bmax[3], bool* mask) const{
+			real enter[max_size], leave[max_size];
+			for(int i = 0; i < size; i++){
+				enter[i] = t_min;
+				leave[i] = t_max[i];
+			}
+			for(int a = 0; a < 3; a++){
+				const real* o = origin[a];
+				const real* inv = inv_dir[a];
+				for(int i = 0; i < size; i++){
+					real t0 = (bmin[a] - o[i]) * inv[i];
+					real t1 = (bmax[a] - o[i]) * inv[i];
+					enter[i] = std::max(enter[i], std::min(t0, t1));
+					leave[i] = std::min(leave[i], std::max(t0, t1));
+				}
+			}
+			bool any = false;
+			for(int i = 0; i < size; i++){
+				mask[i] = enter[i] <= leave[i];
+				any |= mask[i];
+			}
+			return any;
+		}
+
+	private:
+		bool same_signs(const ray& r) const{
+			for(int a = 0; a < 3; a++){
+				bool negative = r.inverse_direction()[a] < 0;
+				if(negative != (inv_dir_bounds[a].max < 0) || negative != (inv_dir_bounds[a].min < 0))
+					return false;
+			}
+			return true;
+		}
+
+		static interval product(const interval& x, const interval& y){
+			real a = x.min*y.min, b = x.min*y.max, c = x.max*y.min, d = x.max*y.max;
+			return interval(std::min({a, b, c, d}), std::max({a, b, c, d}));
+		}
+};
+
+#endif
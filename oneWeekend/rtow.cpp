@@ -1,63 +1,58 @@
 #include "rtweekend.h"
 
 #include "camera.h"
-#include "color.h"
-#include "hittable_list.h"
-#include "material.h"
-#include "sphere.h"
+#include "linear_bvh.h"
+#include "scenes.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Usage: rtow [--time seconds] [--checkpoint file] [--scene file] [image.ppm|image.pfm|image.png]
+// Without an image path a binary PPM goes to stdout. --checkpoint renders progressively,
+// saving to file every minute and resuming from it when it exists; --time stops at a
+// wall-clock limit with the image accumulated so far. --scene renders a scene file (see
+// scene_file.h) instead of the final scene.
+int main(int argc, char** argv){
+	camera cam;
+	final_scene_camera(cam);
+
+	std::string output;
+	std::string scene_path;
+	for(int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if(arg == "--scene" && i + 1 < argc){
+			scene_path = argv[++i];
+		}else if(arg == "--time" && i + 1 < argc){
+			cam.progressive = true;
+			cam.time_limit = std::atof(argv[++i]);
+		}else if(arg == "--checkpoint" && i + 1 < argc){
+			cam.progressive = true;
+			cam.checkpoint_path = argv[++i];
+		}else{
+			output = arg;
+		}
+	}
 
-int main(){
+	material_table materials;
 	hittable_list world;
-
-	auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-	world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
-
-	for(int a = -11; a < 11; a++){
-		for(int b = -11; b < 11; b++){
-			auto choose_mat = random_double();
-			point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-			if((center - point3(4, 0.2, 0)).length() > 0.9){
-				shared_ptr<material> sphere_material;
-
-				if(choose_mat < 0.8){
-					auto albedo = color::random() * color::random();
-					sphere_material = make_shared<lambertian>(albedo);
-					world.add(make_shared<sphere>(center, 0.2, sphere_material));
-				}else if(choose_mat < 0.95){
-					auto albedo = color::random(0.5, 1);
-					auto fuzz = random_double(0, 0.5);
-					sphere_material = make_shared<metal>(albedo, fuzz);
-					world.add(make_shared<sphere>(center, 0.2, sphere_material));
-				}else{
-					sphere_material = make_shared<dielectric>(1.5);
-					world.add(make_shared<sphere>(center, 0.2, sphere_material));
-				}
-			}
+	if(scene_path.empty()){
+		world = final_scene(materials);
+	}else{
+		scene_file scene;
+		if(!scene.load(scene_path)){
+			std::cerr << scene.error() << std::endl;
+			return 1;
 		}
+		if(scene.sphere_count() == 0){
+			std::cerr << scene_path << ": the scene has no spheres to render" << std::endl;
+			return 1;
+		}
+		world = scene_world(scene, materials);
 	}
-
-	auto material1 = make_shared<dielectric>(1.5);
-	world.add(make_shared<sphere>(point3(0,1,0), 1.0, material1));
-	auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-	world.add(make_shared<sphere>(point3(-4,1,0), 1.0, material2));
-	auto material3 = make_shared<metal>(color(0.7,0.6,0.5), 0.0);
-	world.add(make_shared<sphere>(point3(4,1,0), 1.0, material3));
-
-	camera cam;
-
-	cam.aspect_ratio = 16.0/9.0;
-	cam.width = 1200;
-	cam.samples_per_pixel = 500;
-	cam.max_depth = 50;
-
-	cam.vfov = 20;
-	cam.lookfrom = point3(13,2,1);
-	cam.lookat = point3(0,0,0);
-	cam.vup = vec3(0,1,0);
-	
-	cam.defocus_angle = 0.6;
-	cam.focus_dist = 10.0;
+	world = hittable_list(make_shared<linear_bvh>(world));
 	
-	cam.render(world);
+	if(!output.empty())
+		return cam.render(world, materials, output) ? 0 : 1;
+	cam.render(world, materials);
 }
@@ -2,14 +2,25 @@
 #define RTWEEKEND_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <memory>
 
+#include "random.h"
+
 using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
 
+// Scalar type of the geometry, rays and colors of the whole pipeline. Build with
+// -D RTW_FLOAT for single precision; double is the default.
+#if defined(RTW_FLOAT)
+	using real = float;
+#else
+	using real = double;
+#endif
+
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535897932385;
 
@@ -17,8 +28,30 @@ inline double degrees_to_radians(double degrees){
 	return degrees*pi/180.0;
 }
 
+// The generator is picked at build time with -D RTW_RNG_PCG32, -D RTW_RNG_XOSHIRO or
+// -D RTW_RNG_RAND; the counter-based squares generator is the default.
+#if defined(RTW_RNG_PCG32)
+	using rng = pcg32;
+	const char* const rng_name = "pcg32";
+#elif defined(RTW_RNG_XOSHIRO)
+	using rng = xoshiro256plus;
+	const char* const rng_name = "xoshiro256+";
+#elif defined(RTW_RNG_RAND)
+	using rng = c_rand;
+	const char* const rng_name = "rand";
+#else
+	using rng = squares;
+	const char* const rng_name = "squares";
+#endif
+
+// Every thread owns its generator, so workers never contend on a shared state.
+inline rng& thread_rng(){
+	thread_local rng generator;
+	return generator;
+}
+
 inline double random_double(){
-	return rand() / (RAND_MAX + 1.0);
+	return thread_rng().next_double();
 }
 
 inline double random_double(double min, double max){
@@ -0,0 +1,332 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A scene of spheres and their materials, shared by the CPU tracer and the real-time
+// renderer, which read it with scene_world in scenes.h and SphereScene::fromFile.
+//
+// The text form is for writing scenes by hand, one statement per line, # starting a comment:
+//     material <name> lambertian <r> <g> <b>
+//     material <name> metal <r> <g> <b> <fuzz>
+//     material <name> dielectric <index of refraction>
+//     sphere <x> <y> <z> <radius> <material name>
+// The binary form holds the same two arrays as they sit in memory, so a loaded scene
+// points straight into the mapped file and nothing is parsed or copied. It is written
+// in the byte order of the machine that saves it, which is little endian everywhere
+// this builds. load tells the two apart by the binary magic.
+
+// The material types, with the values SphereScene.hpp and frag.glsl use.
+enum scene_material_type : uint32_t{
+	scene_lambertian = 0,
+	scene_metal = 1,
+	scene_dielectric = 2
+};
+
+struct scene_material{
+	uint32_t type;
+	float albedo[3];
+	float fuzz;
+	float ir;
+};
+
+struct scene_sphere{
+	float center[3];
+	float radius;
+	uint32_t material;
+};
+
+static_assert(sizeof(scene_material) == 24 && sizeof(scene_sphere) == 20,
+	"the binary scene format stores these structs as they are");
+
+class scene_file{
+	public:
+		// The first bytes of a binary scene, then the counts and the offsets of the arrays.
+		struct header{
+			char magic[8];
+			uint64_t material_count;
+			uint64_t sphere_count;
+			uint64_t materials_offset;
+			uint64_t spheres_offset;
+		};
+
+		scene_file() {}
+		scene_file(const scene_file&) = delete;
+		scene_file& operator=(const scene_file&) = delete;
+
+		uint32_t add_material(const scene_material& m){
+			detach();
+			owned_materials.push_back(m);
+			point_at_owned();
+			return static_cast<uint32_t>(owned_materials.size() - 1);
+		}
+
+		void add_sphere(float x, float y, float z, float radius, uint32_t material){
+			detach();
+			owned_spheres.push_back(scene_sphere{{x, y, z}, radius, material});
+			point_at_owned();
+		}
+
+		void reserve(size_t materials, size_t spheres){
+			detach();
+			owned_materials.reserve(materials);
+			owned_spheres.reserve(spheres);
+			point_at_owned();
+		}
+
+		size_t material_count() const { return n_materials; }
+		size_t sphere_count() const { return n_spheres; }
+		const scene_material* materials() const { return material_data; }
+		const scene_sphere* spheres() const { return sphere_data; }
+		// Whether the arrays point into a mapped binary file rather than memory of our own.
+		bool is_mapped() const { return file.is_open(); }
+		// What went wrong in the last load, with the line for text scenes.
+		const std::string& error() const { return message; }
+
+		// Reads a text or binary scene, replacing this one. On failure the scene is
+		// empty and error says why.
+		bool load(const std::string& path){
+			clear();
+			if(file.open(path)){
+				if(file.size() >= sizeof(header) && std::memcmp(file.data(), binary_magic, 8) == 0)
+					return attach(path);
+				std::string text(reinterpret_cast<const char*>(file.data()), file.size());
+				file.close();
+				return parse(text, path);
+			}
+			// Without mmap, or for an empty file, read it the ordinary way.
+			std::ifstream in(path, std::ios::binary);
+			if(!in)
+				return fail(path + ": cannot open");
+			std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			if(bytes.size() >= sizeof(header) && std::memcmp(bytes.data(), binary_magic, 8) == 0)
+				return read_binary(bytes, path);
+			return parse(bytes, path);
+		}
+
+		// Writes the text form, naming material i "m<i>".
+		bool save_text(const std::string& path) const{
+			std::ofstream out(path);
+			out.precision(9);
+			for(size_t i=0; i<n_materials; ++i){
+				const scene_material& m = material_data[i];
+				out << "material m" << i;
+				if(m.type == scene_lambertian)
+					out << " lambertian " << m.albedo[0] << ' ' << m.albedo[1] << ' ' << m.albedo[2] << '\n';
+				else if(m.type == scene_metal)
+					out << " metal " << m.albedo[0] << ' ' << m.albedo[1] << ' ' << m.albedo[2] << ' ' << m.fuzz << '\n';
+				else
+					out << " dielectric " << m.ir << '\n';
+			}
+			for(size_t i=0; i<n_spheres; ++i){
+				const scene_sphere& s = sphere_data[i];
+				out << "sphere " << s.center[0] << ' ' << s.center[1] << ' ' << s.center[2] << ' ' << s.radius << " m" << s.material << '\n';
+			}
+			return static_cast<bool>(out);
+		}
+
+		// Writes the binary form, with both arrays at 16-byte aligned offsets.
+		bool save_binary(const std::string& path) const{
+			header h;
+			std::memcpy(h.magic, binary_magic, 8);
+			h.material_count = n_materials;
+			h.sphere_count = n_spheres;
+			h.materials_offset = align16(sizeof(header));
+			h.spheres_offset = align16(h.materials_offset + n_materials * sizeof(scene_material));
+			std::ofstream out(path, std::ios::binary);
+			const char zeros[16] = {};
+			out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+			out.write(zeros, h.materials_offset - sizeof(h));
+			out.write(reinterpret_cast<const char*>(material_data), n_materials * sizeof(scene_material));
+			out.write(zeros, h.spheres_offset - h.materials_offset - n_materials * sizeof(scene_material));
+			out.write(reinterpret_cast<const char*>(sphere_data), n_spheres * sizeof(scene_sphere));
+			return static_cast<bool>(out);
+		}
+
+		void clear(){
+			file.close();
+			owned_materials.clear();
+			owned_spheres.clear();
+			point_at_owned();
+			message.clear();
+		}
+
+	private:
+		static constexpr const char* binary_magic = "RTWSCN1";
+
+		mapped_file file;
+		std::vector<scene_material> owned_materials;
+		std::vector<scene_sphere> owned_spheres;
+		const scene_material* material_data = nullptr;
+		const scene_sphere* sphere_data = nullptr;
+		size_t n_materials = 0;
+		size_t n_spheres = 0;
+		std::string message;
+
+		static uint64_t align16(uint64_t offset) { return (offset + 15) & ~uint64_t(15); }
+
+		void point_at_owned(){
+			material_data = owned_materials.data();
+			sphere_data = owned_spheres.data();
+			n_materials = owned_materials.size();
+			n_spheres = owned_spheres.size();
+		}
+
+		// Adding to a mapped scene first copies it into memory of our own.
+		void detach(){
+			if(!file.is_open())
+				return;
+			owned_materials.assign(material_data, material_data + n_materials);
+			owned_spheres.assign(sphere_data, sphere_data + n_spheres);
+			file.close();
+			point_at_owned();
+		}
+
+		bool fail(const std::string& why){
+			clear();
+			message = why;
+			return false;
+		}
+
+		// Checks a binary scene's header and material references against its size.
+		bool check_binary(const unsigned char* bytes, size_t size, const std::string& path, header& h){
+			std::memcpy(&h, bytes, sizeof(h));
+			bool fits = h.material_count <= size / sizeof(scene_material) && h.sphere_count <= size / sizeof(scene_sphere)
+				&& h.materials_offset % 4 == 0 && h.spheres_offset % 4 == 0
+				&& h.materials_offset <= size && h.material_count * sizeof(scene_material) <= size - h.materials_offset
+				&& h.spheres_offset <= size && h.sphere_count * sizeof(scene_sphere) <= size - h.spheres_offset;
+			if(!fits)
+				return fail(path + ": the binary scene is truncated or corrupt");
+			// One pass over the types and indices keeps every consumer from checking them
+			// again, and keeps the renderers from each guessing at an unknown type.
+			const scene_material* m = reinterpret_cast<const scene_material*>(bytes + h.materials_offset);
+			for(uint64_t i=0; i<h.material_count; ++i)
+				if(m[i].type > scene_dielectric)
+					return fail(path + ": material " + std::to_string(i) + " has an unknown type");
+			const scene_sphere* s = reinterpret_cast<const scene_sphere*>(bytes + h.spheres_offset);
+			for(uint64_t i=0; i<h.sphere_count; ++i)
+				if(s[i].material >= h.material_count)
+					return fail(path + ": sphere " + std::to_string(i) + " uses a material that does not exist");
+			return true;
+		}
+
+		// Points the arrays into the mapped file.
+		bool attach(const std::string& path){
+			header h;
+			if(!check_binary(file.data(), file.size(), path, h))
+				return false;
+			material_data = reinterpret_cast<const scene_material*>(file.data() + h.materials_offset);
+			sphere_data = reinterpret_cast<const scene_sphere*>(file.data() + h.spheres_offset);
+			n_materials = h.material_count;
+			n_spheres = h.sphere_count;
+			return true;
+		}
+
+		// Copies a binary scene that could not be mapped.
+		bool read_binary(const std::string& bytes, const std::string& path){
+			header h;
+			const unsigned char* data = reinterpret_cast<const unsigned char*>(bytes.data());
+			if(!check_binary(data, bytes.size(), path, h))
+				return false;
+			owned_materials.resize(h.material_count);
+			owned_spheres.resize(h.sphere_count);
+			std::memcpy(owned_materials.data(), data + h.materials_offset, h.material_count * sizeof(scene_material));
+			std::memcpy(owned_spheres.data(), data + h.spheres_offset, h.sphere_count * sizeof(scene_sphere));
+			point_at_owned();
+			return true;
+		}
+
+		// Parses the text form; text is null terminated, which strtof relies on.
+		bool parse(const std::string& text, const std::string& path){
+			std::unordered_map<std::string, uint32_t> names;
+			const char* p = text.c_str();
+			const char* end = p + text.size();
+			int line = 0;
+			while(p < end){
+				line++;
+				const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+				if(!eol)
+					eol = end;
+				auto where = [&](){ return path + ":" + std::to_string(line) + ": "; };
+				const char* q = p;
+				std::string keyword = word(q, eol);
+				if(keyword == "material"){
+					std::string name = word(q, eol);
+					std::string type = word(q, eol);
+					scene_material m = {scene_lambertian, {0, 0, 0}, 0, 0};
+					bool ok = !name.empty();
+					if(type == "lambertian"){
+						ok = ok && number(q, eol, m.albedo[0]) && number(q, eol, m.albedo[1]) && number(q, eol, m.albedo[2]);
+					}else if(type == "metal"){
+						m.type = scene_metal;
+						ok = ok && number(q, eol, m.albedo[0]) && number(q, eol, m.albedo[1]) && number(q, eol, m.albedo[2])
+							&& number(q, eol, m.fuzz);
+					}else if(type == "dielectric"){
+						m.type = scene_dielectric;
+						ok = ok && number(q, eol, m.ir);
+					}else{
+						return fail(where() + "unknown material type '" + type + "'");
+					}
+					if(!ok)
+						return fail(where() + "expected material <name> " + type + " and its parameters");
+					if(names.count(name))
+						return fail(where() + "material '" + name + "' is defined twice");
+					names[name] = static_cast<uint32_t>(owned_materials.size());
+					owned_materials.push_back(m);
+				}else if(keyword == "sphere"){
+					scene_sphere s;
+					if(!(number(q, eol, s.center[0]) && number(q, eol, s.center[1]) && number(q, eol, s.center[2])
+							&& number(q, eol, s.radius)))
+						return fail(where() + "expected sphere <x> <y> <z> <radius> <material>");
+					auto found = names.find(word(q, eol));
+					if(found == names.end())
+						return fail(where() + "the sphere's material is not defined above it");
+					s.material = found->second;
+					owned_spheres.push_back(s);
+				}else if(!keyword.empty()){
+					return fail(where() + "unknown statement '" + keyword + "'");
+				}
+				if(!word(q, eol).empty())
+					return fail(where() + "unexpected text at the end of the line");
+				p = eol + 1;
+			}
+			point_at_owned();
+			return true;
+		}
+
+		// The next blank separated word before eol, stopping at a comment.
+		static std::string word(const char*& q, const char* eol){
+			while(q < eol && (*q == ' ' || *q == '\t' || *q == '\r'))
+				q++;
+			if(q == eol || *q == '#'){
+				q = eol;
+				return std::string();
+			}
+			const char* start = q;
+			while(q < eol && *q != ' ' && *q != '\t' && *q != '\r' && *q != '#')
+				q++;
+			return std::string(start, q);
+		}
+
+		static bool number(const char*& q, const char* eol, float& value){
+			char* after = nullptr;
+			value = std::strtof(q, &after);
+			if(after == q || after > eol)
+				return false;
+			q = after;
+			return true;
+		}
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "scene_file.h"
+#include "sphere.h"
+
+inline hittable_list final_scene(material_table& materials){
+	hittable_list world;
+
+	auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+	world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+	for(int a = -11; a < 11; a++){
+		for(int b = -11; b < 11; b++){
+			auto choose_mat = random_double();
+			point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+			if((center - point3(4, 0.2, 0)).length() > 0.9){
+				uint32_t sphere_material;
+
+				if(choose_mat < 0.8){
+					auto albedo = color::random() * color::random();
+					sphere_material = materials.add(lambertian(albedo));
+					world.add(make_shared<sphere>(center, 0.2, sphere_material));
+				}else if(choose_mat < 0.95){
+					auto albedo = color::random(0.5, 1);
+					auto fuzz = random_double(0, 0.5);
+					sphere_material = materials.add(metal(albedo, fuzz));
+					world.add(make_shared<sphere>(center, 0.2, sphere_material));
+				}else{
+					sphere_material = materials.add(dielectric(1.5));
+					world.add(make_shared<sphere>(center, 0.2, sphere_material));
+				}
+			}
+		}
+	}
+
+	auto material1 = materials.add(dielectric(1.5));
+	world.add(make_shared<sphere>(point3(0,1,0), 1.0, material1));
+	auto material2 = materials.add(lambertian(color(0.4, 0.2, 0.1)));
+	world.add(make_shared<sphere>(point3(-4,1,0), 1.0, material2));
+	auto material3 = materials.add(metal(color(0.7,0.6,0.5), 0.0));
+	world.add(make_shared<sphere>(point3(4,1,0), 1.0, material3));
+
+	return world;
+}
+
+// A cloud of n small spheres spread through a cube that grows with n, for measuring
+// how intersection cost scales with scene size.
+inline hittable_list random_spheres(int n, material_table& materials){
+	hittable_list world;
+	world.objects.reserve(n);
+
+	auto side = 10 * std::cbrt(static_cast<double>(n));
+	auto radius = 0.4;
+	auto grey = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+	for(int i=0; i<n; ++i){
+		point3 center = vec3::random(-side/2, side/2);
+		world.add(make_shared<sphere>(center, radius, grey));
+	}
+
+	return world;
+}
+
+// The world of a loaded scene file, with one material object per material of the file
+// however many spheres share it. The file's material indices become table ids offset by
+// the materials already in the table.
+inline hittable_list scene_world(const scene_file& scene, material_table& materials){
+	auto first = static_cast<uint32_t>(materials.size());
+	for(size_t i=0; i<scene.material_count(); ++i){
+		const scene_material& m = scene.materials()[i];
+		color albedo(m.albedo[0], m.albedo[1], m.albedo[2]);
+		if(m.type == scene_metal)
+			materials.add(metal(albedo, m.fuzz));
+		else if(m.type == scene_dielectric)
+			materials.add(dielectric(m.ir));
+		else
+			materials.add(lambertian(albedo));
+	}
+
+	hittable_list world;
+	world.objects.reserve(scene.sphere_count());
+	for(size_t i=0; i<scene.sphere_count(); ++i){
+		const scene_sphere& s = scene.spheres()[i];
+		world.add(make_shared<sphere>(point3(s.center[0], s.center[1], s.center[2]), s.radius, first + s.material));
+	}
+	return world;
+}
+
+inline void final_scene_camera(camera& cam){
+	cam.aspect_ratio = 16.0/9.0;
+	cam.width = 1200;
+	cam.samples_per_pixel = 500;
+	cam.max_depth = 50;
+
+	cam.vfov = 20;
+	cam.lookfrom = point3(13,2,1);
+	cam.lookat = point3(0,0,0);
+	cam.vup = vec3(0,1,0);
+	
+	cam.defocus_angle = 0.6;
+	cam.focus_dist = 10.0;
+}
+
+#endif
@@ -6,7 +6,10 @@
 
 class sphere : public hittable{
 	public:
-		sphere(point3 _center, double _radius, shared_ptr<material> _material) : center(_center), radius(_radius), mat(_material) {}
+		sphere(point3 _center, real _radius, uint32_t _material_id) : center(_center), radius(_radius), material_id(_material_id){
+			auto rvec = vec3(radius, radius, radius);
+			bbox = aabb(center - rvec, center + rvec);
+		}
 		
 		bool hit(const ray& r, interval ray_t, hit_record& rec) const override{
 			vec3 oc = r.origin() - center;
@@ -27,17 +30,27 @@ class sphere : public hittable{
 				}
 			}
 			rec.t = root;
+			rec.object = this;
+			rec.material_id = material_id;
+
+			return true;
+		}
+
+		void fill_surface(const ray& r, hit_record& rec) const override{
 			rec.p = r.at(rec.t);
 			vec3 outward_normal = (rec.p - center) / radius;
 			rec.set_face_normal(r, outward_normal);
-			rec.mat = mat;
-
-			return true;
 		}
+
+		aabb bounding_box() const override { return bbox; }
+
 	private:
+		friend class sphere_soa;
+
 		point3 center;
-		double radius;
-		shared_ptr<material> mat;
+		real radius;
+		uint32_t material_id;
+		aabb bbox;
 };
 
 #endif
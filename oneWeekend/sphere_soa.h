@@ -0,0 +1,317 @@
+#ifndef SPHERE_SOA_H
+#define SPHERE_SOA_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "sphere.h"
+
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+
+// AVX2 tests 8 spheres per step and SSE 4. Building with -D RTW_NO_SIMD (or for a target
+// without SSE) selects the scalar loop, which works on blocks of 8 as well.
+#if defined(__AVX2__) && !defined(RTW_NO_SIMD)
+	#include <immintrin.h>
+	#define RTW_SOA_AVX2
+#elif (defined(__SSE2__) || defined(_M_X64)) && !defined(RTW_NO_SIMD)
+	#include <emmintrin.h>
+	#define RTW_SOA_SSE
+#endif
+
+template<typename T, size_t alignment>
+struct aligned_allocator{
+	using value_type = T;
+
+	template<typename U>
+	struct rebind { using other = aligned_allocator<U, alignment>; };
+
+	aligned_allocator() = default;
+	template<typename U>
+	aligned_allocator(const aligned_allocator<U, alignment>&) {}
+
+	T* allocate(size_t n){
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+	}
+
+	void deallocate(T* p, size_t){
+		::operator delete(p, std::align_val_t(alignment));
+	}
+
+	bool operator==(const aligned_allocator&) const { return true; }
+	bool operator!=(const aligned_allocator&) const { return false; }
+};
+
+// Spheres stored as separate aligned float arrays so one ray is tested against a whole
+// block of them per step. Single precision only decides which spheres the ray might hit:
+// every lane gets a conservative bound on its roots, the horizontal minimum of the block
+// rejects it outright when nothing can beat the closest hit so far, and the surviving
+// lanes are confirmed nearest first with the same full-precision test (in real, double
+// unless built with RTW_FLOAT) as sphere::hit. The result is therefore identical to a
+// hittable_list of spheres.
+class sphere_soa : public hittable{
+	public:
+		static const int block_size = 8;
+
+		sphere_soa() {}
+
+		// Takes every sphere out of a list; other kinds of objects are ignored.
+		sphere_soa(const hittable_list& list){
+			for(const auto& object : list.objects)
+				if(auto s = dynamic_cast<const sphere*>(object.get()))
+					add(s->center, s->radius, s->material_id);
+		}
+
+		void add(const point3& center, real radius, uint32_t material_id){
+			size_t index = count++;
+			if(index % block_size == 0)
+				grow();
+
+			cx[index] = static_cast<float>(center.x());
+			cy[index] = static_cast<float>(center.y());
+			cz[index] = static_cast<float>(center.z());
+			rr[index] = static_cast<float>(radius);
+			material_ids.push_back(material_id);
+			exact.push_back({center, radius});
+
+			auto rvec = vec3(radius, radius, radius);
+			bbox = aabb(bbox, aabb(center - rvec, center + rvec));
+		}
+
+		size_t size() const { return count; }
+
+		bool hit(const ray& r, interval ray_t, hit_record& rec) const override{
+			ray_lanes lanes(r);
+			bool hit_anything = false;
+			alignas(32) float keys[block_size];
+
+			for(size_t base = 0; base < count; base += block_size){
+				unsigned mask = block_keys(lanes, base, static_cast<float>(ray_t.min), static_cast<float>(ray_t.max), keys);
+				if(mask == 0)
+					continue;
+
+				// Confirm candidates nearest first; anything whose lower bound lies past the
+				// closest confirmed hit can no longer win.
+				while(mask){
+					int best = -1;
+					for(unsigned m = mask; m; m &= m - 1){
+						int lane = ctz(m);
+						if(best < 0 || keys[lane] < keys[best])
+							best = lane;
+					}
+					mask &= ~(1u << best);
+					if(keys[best] > ray_t.max)
+						break;
+					if(hit_exact(base + best, r, ray_t, rec)){
+						hit_anything = true;
+						ray_t.max = rec.t;
+					}
+				}
+			}
+
+			return hit_anything;
+		}
+
+		aabb bounding_box() const override { return bbox; }
+
+		void fill_surface(const ray& r, hit_record& rec) const override{
+			const exact_sphere& s = exact[rec.primitive];
+			rec.p = r.at(rec.t);
+			vec3 outward_normal = (rec.p - s.center) / s.radius;
+			rec.set_face_normal(r, outward_normal);
+		}
+
+	private:
+		using float_array = std::vector<float, aligned_allocator<float, 32>>;
+
+		struct exact_sphere{
+			point3 center;
+			real radius;
+		};
+
+		struct ray_lanes{
+			float ox, oy, oz;
+			float dx, dy, dz;
+			float a, inv_a;
+
+			ray_lanes(const ray& r){
+				ox = static_cast<float>(r.origin().x());
+				oy = static_cast<float>(r.origin().y());
+				oz = static_cast<float>(r.origin().z());
+				dx = static_cast<float>(r.direction().x());
+				dy = static_cast<float>(r.direction().y());
+				dz = static_cast<float>(r.direction().z());
+				a = dx*dx + dy*dy + dz*dz;
+				inv_a = 1.0f / a;
+			}
+		};
+
+		// Relative slack covering single-precision rounding in the discriminant and roots.
+		static constexpr float disc_tolerance = 1e-5f;
+		static constexpr float root_tolerance = 1e-4f;
+
+		float_array cx, cy, cz, rr;
+		std::vector<uint32_t> material_ids;
+		std::vector<exact_sphere> exact;
+		size_t count = 0;
+		aabb bbox;
+
+		// Unused lanes hold NaN centres, which fail every comparison.
+		void grow(){
+			const float nan = std::numeric_limits<float>::quiet_NaN();
+			size_t padded = cx.size() + block_size;
+			cx.resize(padded, nan);
+			cy.resize(padded, nan);
+			cz.resize(padded, nan);
+			rr.resize(padded, 0.0f);
+		}
+
+		static int ctz(unsigned m){
+			int n = 0;
+			while(!(m & 1u)){
+				m >>= 1;
+				n++;
+			}
+			return n;
+		}
+
+		bool hit_exact(size_t i, const ray& r, const interval& ray_t, hit_record& rec) const{
+			const exact_sphere& s = exact[i];
+			vec3 oc = r.origin() - s.center;
+			auto a = r.direction().length_squared();
+			auto h_b = dot(oc, r.direction());
+			auto c = oc.length_squared() - s.radius*s.radius;
+			auto disc = h_b*h_b - a*c;
+
+			if(disc<0) return false;
+			auto sqrtd = sqrt(disc);
+
+			auto root = (-h_b - sqrtd)/a;
+
+			if(!ray_t.surrounds(root)){
+				root = (-h_b + sqrtd)/a;
+				if(!ray_t.surrounds(root)){
+					return false;
+				}
+			}
+			rec.t = root;
+			rec.object = this;
+			rec.primitive = static_cast<uint32_t>(i);
+			rec.material_id = material_ids[i];
+
+			return true;
+		}
+
+		// Writes a lower bound on the entry distance of every lane in the block to keys
+		// (infinity for lanes that cannot hit within [tmin, tmax]) and returns the mask of
+		// candidate lanes, or 0 when the horizontal minimum already lies beyond tmax.
+		unsigned block_keys(const ray_lanes& l, size_t base, float tmin, float tmax, float* keys) const{
+#if defined(RTW_SOA_AVX2)
+			const __m256 sign = _mm256_set1_ps(-0.0f);
+			__m256 ocx = _mm256_sub_ps(_mm256_set1_ps(l.ox), _mm256_load_ps(&cx[base]));
+			__m256 ocy = _mm256_sub_ps(_mm256_set1_ps(l.oy), _mm256_load_ps(&cy[base]));
+			__m256 ocz = _mm256_sub_ps(_mm256_set1_ps(l.oz), _mm256_load_ps(&cz[base]));
+			__m256 r = _mm256_load_ps(&rr[base]);
+			__m256 a = _mm256_set1_ps(l.a);
+
+			__m256 h = _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(ocx, _mm256_set1_ps(l.dx)), _mm256_mul_ps(ocy, _mm256_set1_ps(l.dy))),
+				_mm256_mul_ps(ocz, _mm256_set1_ps(l.dz)));
+			__m256 oc2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+			__m256 r2 = _mm256_mul_ps(r, r);
+			__m256 hh = _mm256_mul_ps(h, h);
+			__m256 disc = _mm256_sub_ps(hh, _mm256_mul_ps(a, _mm256_sub_ps(oc2, r2)));
+			__m256 tol = _mm256_mul_ps(_mm256_set1_ps(disc_tolerance), _mm256_add_ps(hh, _mm256_mul_ps(a, _mm256_add_ps(oc2, r2))));
+
+			__m256 cand = _mm256_cmp_ps(_mm256_add_ps(disc, tol), _mm256_setzero_ps(), _CMP_GE_OQ);
+			__m256 sq = _mm256_sqrt_ps(_mm256_add_ps(_mm256_max_ps(disc, _mm256_setzero_ps()), tol));
+			__m256 inv_a = _mm256_set1_ps(l.inv_a);
+			__m256 err = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(root_tolerance), inv_a), _mm256_add_ps(_mm256_andnot_ps(sign, h), sq));
+			__m256 t_lo = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_xor_ps(h, sign), sq), inv_a), err);
+			__m256 t_hi = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_xor_ps(h, sign), sq), inv_a), err);
+
+			cand = _mm256_and_ps(cand, _mm256_cmp_ps(t_hi, _mm256_set1_ps(tmin), _CMP_GE_OQ));
+			cand = _mm256_and_ps(cand, _mm256_cmp_ps(t_lo, _mm256_set1_ps(tmax), _CMP_LE_OQ));
+			__m256 key = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), t_lo, cand);
+
+			__m256 m = _mm256_min_ps(key, _mm256_permute2f128_ps(key, key, 1));
+			m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+			m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+			if(_mm256_cvtss_f32(m) > tmax)
+				return 0;
+
+			_mm256_store_ps(keys, key);
+			return static_cast<unsigned>(_mm256_movemask_ps(cand));
+#elif defined(RTW_SOA_SSE)
+			unsigned mask = 0;
+			const __m128 sign = _mm_set1_ps(-0.0f);
+			const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+			__m128 best = inf;
+			for(int half = 0; half < block_size; half += 4){
+				size_t i = base + half;
+				__m128 ocx = _mm_sub_ps(_mm_set1_ps(l.ox), _mm_load_ps(&cx[i]));
+				__m128 ocy = _mm_sub_ps(_mm_set1_ps(l.oy), _mm_load_ps(&cy[i]));
+				__m128 ocz = _mm_sub_ps(_mm_set1_ps(l.oz), _mm_load_ps(&cz[i]));
+				__m128 r = _mm_load_ps(&rr[i]);
+				__m128 a = _mm_set1_ps(l.a);
+
+				__m128 h = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(ocx, _mm_set1_ps(l.dx)), _mm_mul_ps(ocy, _mm_set1_ps(l.dy))),
+					_mm_mul_ps(ocz, _mm_set1_ps(l.dz)));
+				__m128 oc2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz));
+				__m128 r2 = _mm_mul_ps(r, r);
+				__m128 hh = _mm_mul_ps(h, h);
+				__m128 disc = _mm_sub_ps(hh, _mm_mul_ps(a, _mm_sub_ps(oc2, r2)));
+				__m128 tol = _mm_mul_ps(_mm_set1_ps(disc_tolerance), _mm_add_ps(hh, _mm_mul_ps(a, _mm_add_ps(oc2, r2))));
+
+				__m128 cand = _mm_cmpge_ps(_mm_add_ps(disc, tol), _mm_setzero_ps());
+				__m128 sq = _mm_sqrt_ps(_mm_add_ps(_mm_max_ps(disc, _mm_setzero_ps()), tol));
+				__m128 inv_a = _mm_set1_ps(l.inv_a);
+				__m128 err = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(root_tolerance), inv_a), _mm_add_ps(_mm_andnot_ps(sign, h), sq));
+				__m128 t_lo = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(_mm_xor_ps(h, sign), sq), inv_a), err);
+				__m128 t_hi = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_xor_ps(h, sign), sq), inv_a), err);
+
+				cand = _mm_and_ps(cand, _mm_cmpge_ps(t_hi, _mm_set1_ps(tmin)));
+				cand = _mm_and_ps(cand, _mm_cmple_ps(t_lo, _mm_set1_ps(tmax)));
+				__m128 key = _mm_or_ps(_mm_and_ps(cand, t_lo), _mm_andnot_ps(cand, inf));
+
+				best = _mm_min_ps(best, key);
+				_mm_store_ps(keys + half, key);
+				mask |= static_cast<unsigned>(_mm_movemask_ps(cand)) << half;
+			}
+
+			best = _mm_min_ps(best, _mm_movehl_ps(best, best));
+			best = _mm_min_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 1, 1, 1)));
+			return (_mm_cvtss_f32(best) > tmax) ? 0 : mask;
+#else
+			unsigned mask = 0;
+			for(int lane = 0; lane < block_size; lane++){
+				size_t i = base + lane;
+				float ocx = l.ox - cx[i], ocy = l.oy - cy[i], ocz = l.oz - cz[i];
+				float h = ocx*l.dx + ocy*l.dy + ocz*l.dz;
+				float oc2 = ocx*ocx + ocy*ocy + ocz*ocz;
+				float r2 = rr[i]*rr[i];
+				float disc = h*h - l.a*(oc2 - r2);
+				float tol = disc_tolerance * (h*h + l.a*(oc2 + r2));
+
+				keys[lane] = std::numeric_limits<float>::infinity();
+				if(!(disc + tol >= 0))
+					continue;
+				float sq = std::sqrt(std::fmax(disc, 0.0f) + tol);
+				float err = root_tolerance * l.inv_a * (std::fabs(h) + sq);
+				float t_lo = (-h - sq)*l.inv_a - err;
+				float t_hi = (-h + sq)*l.inv_a + err;
+				if(t_hi >= tmin && t_lo <= tmax){
+					keys[lane] = t_lo;
+					mask |= 1u << lane;
+				}
+			}
+			return mask;
+#endif
+		}
+};
+
+#endif
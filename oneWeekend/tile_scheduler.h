@@ -0,0 +1,93 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct tile{
+	int x0, y0;
+	int x1, y1;
+};
+
+inline std::vector<tile> make_tiles(int width, int height, int tile_size){
+	std::vector<tile> tiles;
+	for(int y=0; y<height; y+=tile_size)
+		for(int x=0; x<width; x+=tile_size)
+			tiles.push_back({x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+	return tiles;
+}
+
+// Runs a job per tile on a fixed pool of threads. Every worker starts with its own
+// contiguous slice of the tiles and, once that runs dry, steals from the front of the
+// other workers' queues, so one slow region of the image does not leave cores idle.
+class tile_scheduler{
+	public:
+		explicit tile_scheduler(int threads = 0){
+			thread_count = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+			thread_count = (thread_count < 1) ? 1 : thread_count;
+		}
+
+		int threads() const { return thread_count; }
+
+		template<typename Job>
+		void run(const std::vector<tile>& tiles, Job job){
+			int n = thread_count;
+			std::vector<work_queue> queues(n);
+			for(int i=0; i<static_cast<int>(tiles.size()); ++i)
+				queues[static_cast<long>(i) * n / tiles.size()].tiles.push_back(i);
+
+			auto worker = [&](int self){
+				int index;
+				while(pop(queues[self], index) || steal(queues, self, index))
+					job(tiles[index]);
+			};
+
+			if(n == 1){
+				worker(0);
+				return;
+			}
+
+			std::vector<std::thread> pool;
+			for(int t=1; t<n; ++t)
+				pool.emplace_back(worker, t);
+			worker(0);
+			for(auto& thread : pool)
+				thread.join();
+		}
+
+	private:
+		struct work_queue{
+			std::mutex lock;
+			std::deque<int> tiles;
+		};
+
+		int thread_count;
+
+		static bool pop(work_queue& queue, int& index){
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if(queue.tiles.empty())
+				return false;
+			index = queue.tiles.back();
+			queue.tiles.pop_back();
+			return true;
+		}
+
+		static bool steal(std::vector<work_queue>& queues, int self, int& index){
+			int n = static_cast<int>(queues.size());
+			for(int k=1; k<n; ++k){
+				work_queue& victim = queues[(self + k) % n];
+				std::lock_guard<std::mutex> guard(victim.lock);
+				if(!victim.tiles.empty()){
+					index = victim.tiles.front();
+					victim.tiles.pop_front();
+					return true;
+				}
+			}
+			return false;
+		}
+};
+
+#endif
@@ -6,44 +6,45 @@
 
 using std::sqrt;
 
-class vec3{
+template<typename T>
+class vec3_t{
 	public:
-		double e[3];
+		T e[3];
 
-		vec3() : e{0,0,0} {}
-		vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+		vec3_t() : e{0,0,0} {}
+		vec3_t(T e0, T e1, T e2) : e{e0, e1, e2} {}
 
-		double x() const { return e[0]; }
-		double y() const { return e[1]; }
-		double z() const { return e[2]; }
+		T x() const { return e[0]; }
+		T y() const { return e[1]; }
+		T z() const { return e[2]; }
 
-		vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-		double operator[](int i) const { return e[i]; }
-		double& operator[](int i) { return e[i]; }
+		vec3_t operator-() const { return vec3_t(-e[0], -e[1], -e[2]); }
+		T operator[](int i) const { return e[i]; }
+		T& operator[](int i) { return e[i]; }
 
-		vec3& operator+=(const vec3 &v){
+		vec3_t& operator+=(const vec3_t &v){
 			e[0] += v.e[0];
 			e[1] += v.e[1];
 			e[2] += v.e[2];
 			return *this;
 		}
 
-		vec3& operator*=(double t){
+		vec3_t& operator*=(T t){
 			e[0] *= t;
 			e[1] *= t;
 			e[2] *= t;
 			return *this;
 		}
 
-		vec3& operator/=(double t){
+		vec3_t& operator/=(T t){
 			return *this *= 1/t;
 		}
 
-		double length() const{
+		T length() const{
 			return sqrt(length_squared());
 		}
 
-		double length_squared() const{
+		T length_squared() const{
 			return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
 		}
 
@@ -52,60 +53,63 @@ class vec3{
 			return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s); 
 		}
 
-		static vec3 random(){
-			return vec3(random_double(), random_double(), random_double());
+		static vec3_t random(){
+			return vec3_t(random_double(), random_double(), random_double());
 		}
 
-		static vec3 random(double min, double max){
-			return vec3(random_double(min,max), random_double(min,max), random_double(min,max));
+		static vec3_t random(double min, double max){
+			return vec3_t(random_double(min,max), random_double(min,max), random_double(min,max));
 		}
-};
 
-using point3 = vec3;
+		// The operators are friends defined in the class so they are plain functions of
+		// vec3_t<T>: a double literal still converts to T, as it did before the template.
+		friend std::ostream& operator<<(std::ostream &out, const vec3_t &v){
+			return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
+		}
 
-inline std::ostream& operator<<(std::ostream &out, const vec3 &v){
-	return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
-}
+		friend vec3_t operator+(const vec3_t &u, const vec3_t &v){
+			return vec3_t(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+		}
 
-inline vec3 operator+(const vec3 &u, const vec3 &v){
-	return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
-}
+		friend vec3_t operator-(const vec3_t &u, const vec3_t &v){
+			return vec3_t(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+		}
 
-inline vec3 operator-(const vec3 &u, const vec3 &v){
-	return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
-}
+		friend vec3_t operator*(const vec3_t &u, const vec3_t &v){
+			return vec3_t(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+		}
 
-inline vec3 operator*(const vec3 &u, const vec3 &v){
-	return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
-}
+		friend vec3_t operator*(T t, const vec3_t &v){
+			return vec3_t(t*v.e[0], t*v.e[1], t*v.e[2]);
+		}
 
-inline vec3 operator*(double t, const vec3 &v){
-	return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
-}
+		friend vec3_t operator*(const vec3_t &v, T t){
+			return t * v;
+		}
 
-inline vec3 operator*(const vec3 &v, double t){
-	return t * v;
-}
+		friend vec3_t operator/(vec3_t v, T t){
+			return (1/t) * v;
+		}
 
-inline vec3 operator/(vec3 v, double t){
-	return (1/t) * v;
-}
+		friend T dot(const vec3_t &u, const vec3_t &v){
+			return u.e[0] * v.e[0]
+				+ u.e[1] * v.e[1]
+				+ u.e[2] * v.e[2];
+		}
 
-inline double dot(const vec3 &u, const vec3 &v){
-	return u.e[0] * v.e[0]
-		+ u.e[1] * v.e[1]
-		+ u.e[2] * v.e[2];
-}
+		friend vec3_t cross(const vec3_t &u, const vec3_t &v){
+			return vec3_t(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+					u.e[2] * v.e[0] - u.e[0] * v.e[2],
+					u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+		}
 
-inline vec3 cross(const vec3 &u, const vec3 &v){
-	return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-			u.e[2] * v.e[0] - u.e[0] * v.e[2],
-			u.e[0] * v.e[1] - u.e[1] * v.e[0]);
-}
+		friend vec3_t unit_vector(vec3_t v){
+			return v/v.length();
+		}
+};
 
-inline vec3 unit_vector(vec3 v){
-	return v/v.length();
-}
+using vec3 = vec3_t<real>;
+using point3 = vec3;
 
 inline vec3 random_in_unit_disk(){
 	while(true){
@@ -139,8 +143,8 @@ inline vec3 reflect(const vec3& v, const vec3& n){
 	return v - 2*dot(v,n)*n;
 }
 
-inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat){
-	auto cos_theta = fmin(dot(-uv,n), 1.0);
+inline vec3 refract(const vec3& uv, const vec3& n, real etai_over_etat){
+	real cos_theta = fmin(dot(-uv,n), 1.0);
 	vec3 r_out_perp = etai_over_etat * (uv + cos_theta*n);
 	vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared())) * n;
 	return r_out_perp + r_out_parallel;
@@ -0,0 +1,162 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "material.h"
+#include "tile_scheduler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Wall time spent in each stage of a wavefront render, in seconds.
+class wavefront_stats{
+	public:
+		double generate = 0;
+		double extend = 0;
+		double shade = 0;
+		double connect = 0;
+		long paths = 0;
+		long rays = 0;
+
+		void print(std::ostream& out) const{
+			out << "Wavefront: " << paths << " paths, " << rays << " rays; generate " << generate
+				<< " s, extend " << extend << " s, shade " << shade << " s, connect " << connect << " s\n";
+		}
+};
+
+// The state of every path in flight, one array per field. A path is the current ray of
+// one sample of one pixel plus the throughput it has accumulated; after the extend
+// stage it also carries the closest hit of that ray.
+class path_buffer{
+	public:
+		std::vector<real> origin[3], direction[3], throughput[3];
+		std::vector<uint32_t> pixel, sample;
+		std::vector<uint16_t> bounce;
+
+		std::vector<uint8_t> hit;
+		std::vector<real> hit_t, hit_p[3], hit_normal[3];
+		std::vector<uint8_t> front_face;
+		std::vector<uint32_t> hit_material;
+
+		std::vector<real> radiance[3];
+		std::vector<uint8_t> done;
+
+		size_t size = 0;
+
+		void reserve(size_t capacity){
+			for(int a = 0; a < 3; a++){
+				origin[a].resize(capacity);
+				direction[a].resize(capacity);
+				throughput[a].resize(capacity);
+				hit_p[a].resize(capacity);
+				hit_normal[a].resize(capacity);
+				radiance[a].resize(capacity);
+			}
+			pixel.resize(capacity);
+			sample.resize(capacity);
+			bounce.resize(capacity);
+			hit.resize(capacity);
+			hit_t.resize(capacity);
+			front_face.resize(capacity);
+			hit_material.resize(capacity);
+			done.resize(capacity);
+		}
+
+		size_t capacity() const { return pixel.size(); }
+
+		ray get_ray(size_t i) const{
+			return ray(point3(origin[0][i], origin[1][i], origin[2][i]), vec3(direction[0][i], direction[1][i], direction[2][i]));
+		}
+
+		void set_ray(size_t i, const ray& r){
+			for(int a = 0; a < 3; a++){
+				origin[a][i] = r.origin()[a];
+				direction[a][i] = r.direction()[a];
+			}
+		}
+
+		hit_record get_hit(size_t i) const{
+			hit_record rec;
+			rec.p = point3(hit_p[0][i], hit_p[1][i], hit_p[2][i]);
+			rec.normal = vec3(hit_normal[0][i], hit_normal[1][i], hit_normal[2][i]);
+			rec.t = hit_t[i];
+			rec.front_face = front_face[i];
+			rec.material_id = hit_material[i];
+			return rec;
+		}
+
+		void set_hit(size_t i, const hit_record& rec){
+			for(int a = 0; a < 3; a++){
+				hit_p[a][i] = rec.p[a];
+				hit_normal[a][i] = rec.normal[a];
+			}
+			hit_t[i] = rec.t;
+			front_face[i] = rec.front_face;
+			hit_material[i] = rec.material_id;
+		}
+
+		// Moves path `from` into slot `to`, used when compacting finished paths away.
+		void move(size_t from, size_t to){
+			for(int a = 0; a < 3; a++){
+				origin[a][to] = origin[a][from];
+				direction[a][to] = direction[a][from];
+				throughput[a][to] = throughput[a][from];
+			}
+			pixel[to] = pixel[from];
+			sample[to] = sample[from];
+			bounce[to] = bounce[from];
+			done[to] = done[from];
+		}
+};
+
+// Calls job(begin, end) over [0, n) in chunks spread across the scheduler's threads.
+// A single chunk runs on the calling thread, which keeps the long tail of nearly empty
+// bounces from paying for thread startup.
+template<typename Job>
+void parallel_chunks(tile_scheduler& scheduler, size_t n, size_t chunk, Job job){
+	if(n <= chunk || scheduler.threads() == 1){
+		job(0, n);
+		return;
+	}
+	std::vector<tile> chunks;
+	for(size_t begin = 0; begin < n; begin += chunk)
+		chunks.push_back({static_cast<int>(begin), 0, static_cast<int>(std::min(n, begin + chunk)), 1});
+	scheduler.run(chunks, [&](const tile& t){ job(static_cast<size_t>(t.x0), static_cast<size_t>(t.x1)); });
+}
+
+// Groups paths by the kind of material they hit, keeping queue order inside each
+// group so the result does not depend on thread timing. Misses come last.
+class material_sorter{
+	public:
+		void sort(const path_buffer& paths, const material_table& materials, std::vector<uint32_t>& order){
+			keys.resize(paths.size);
+			for(size_t i=0; i<paths.size; ++i)
+				keys[i] = paths.hit[i] ? materials.kind(paths.hit_material[i]) : material_kinds;
+
+			size_t starts[material_kinds + 2] = {};
+			for(uint32_t key : keys)
+				starts[key + 1]++;
+			for(size_t b = 1; b < material_kinds + 2; ++b)
+				starts[b] += starts[b - 1];
+
+			order.resize(paths.size);
+			for(size_t i=0; i<paths.size; ++i)
+				order[starts[keys[i]]++] = static_cast<uint32_t>(i);
+		}
+
+		// The paths as they sit in the queue, for shading without sorting.
+		void queue_order(const path_buffer& paths, std::vector<uint32_t>& order){
+			order.resize(paths.size);
+			for(size_t i=0; i<paths.size; ++i)
+				order[i] = static_cast<uint32_t>(i);
+		}
+
+	private:
+		std::vector<uint32_t> keys;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#version 410 core
+
+// ===================================================== Uniforms =====================================================
+uniform sampler2D u_accumulation; // the linear running average written by frag.glsl
+uniform vec2 u_renderSize; // the lower left part of u_accumulation frag.glsl traced into; the whole texture at full resolution
+
+// ======================================================== Out ========================================================
+out vec4 fragColor;
+
+void main()
+{
+	// Gamma 2 like the single-frame shader used to apply; the texture matches the window
+	vec2 windowSize = vec2(textureSize(u_accumulation, 0));
+	vec3 average;
+	if (u_renderSize == windowSize) {
+		average = texelFetch(u_accumulation, ivec2(gl_FragCoord.xy), 0).rgb; // one texel per pixel, nothing to filter
+	} else {
+		// Stretch the traced part over the window, filtering the linear average before the gamma
+		// Staying half a texel inside keeps the filter from blending in texels that were not traced
+		vec2 position = clamp(gl_FragCoord.xy * u_renderSize / windowSize, vec2(0.5), u_renderSize - 0.5);
+		average = texture(u_accumulation, position / windowSize).rgb;
+	}
+	fragColor = vec4(sqrt(average), 1.0);
+}
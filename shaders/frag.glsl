@@ -2,10 +2,18 @@
 #version 410 core
 
 // ===================================================== Uniforms =====================================================
-uniform sampler2D u_diffuseMap;
-uniform vec2 u_resolution;
-uniform float u_time;
-uniform float u_camSpin;
+uniform sampler2D u_history; // the running average of the previous frames
+uniform samplerBuffer u_spheres; // SPHERE_TEXELS RGBA32F texels per sphere, see SphereScene.hpp
+uniform samplerBuffer u_bvh; // BVH_TEXELS RGBA32F texels per node, see SphereBVH.hpp
+
+// Everything that changes per frame, uploaded in one piece; mirrored by FrameUniforms in FrameBuffer.hpp
+layout(std140) uniform FrameUniforms {
+	vec2 u_resolution;
+	float u_time;
+	float u_camSpin;
+	int u_frame; // how many frames u_history averages; 0 after the camera moves
+	int u_sphereCount;
+};
 
 // ======================================================== In ========================================================
 vec2 fragCoord = gl_FragCoord.xy;
@@ -16,7 +24,9 @@ out vec4 fragColor;
 #define PI 3.14159265359
 #define SAMPLES_PER_PIXEL 10.0
 #define MAX_RAY_BOUNCES 6
-#define SPHERE_COUNT 24
+#define SPHERE_TEXELS 3
+#define BVH_TEXELS 2
+#define BVH_STACK_SIZE 32 // BVH_MAX_DEPTH in SphereBVH.hpp
 
 float rand12(vec2 p) {
 	vec3 p3  = fract(vec3(p.xyx) * 0.1031);
@@ -52,8 +62,13 @@ vec3 random_in_unit_sphere(vec2 p) {
 	return vec3(x, y, z);
 }
 
+// The direction part of random_in_unit_sphere; normalizing that point gave NaN whenever its radius hashed to 0
 vec3 random_unit_vector(vec2 p) {
-	return normalize(random_in_unit_sphere(p));
+	vec3 rand = rand32(p);
+	float phi = 2.0 * PI * rand.x;
+	float cosTheta = 2.0 * rand.y - 1.0;
+	float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+	return vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
 }
 
 vec3 random_in_unit_disk(vec2 p) {
@@ -89,32 +104,13 @@ struct sphere {
 	material material;
 };
 
-const sphere spheres[SPHERE_COUNT] = sphere[](
-sphere(vec3( 0.0, -1000.0, -1.0), 1000.0, material(material_lambertian, vec3(0.5, 0.5, 0.5), 0.0, 0.0)),
-sphere(vec3(-4.0, 1.0, 2.0), 	  1.0, 	  material(material_dielectric, vec3(0.0, 0.0, 0.0), 0.0, 1.5)),
-sphere(vec3( 0.0, 1.0, 0.0), 	  1.0, 	  material(material_metal, 	    vec3(0.7, 0.6, 0.5), 0.0, 0.0)),
-sphere(vec3( 4.0, 1.0, 2.0), 	  1.0, 	  material(material_lambertian, vec3(0.7, 0.3, 0.3), 0.0, 0.0)),
-sphere(vec3(-6.0, 0.2, 2.8), 	  0.2, 	  material(material_dielectric, vec3(0.0, 0.0, 0.2), 0.0, 1.5)),
-sphere(vec3(1.6, 0.2, -0.9), 	  0.2, 	  material(material_dielectric, vec3(0.0, 0.0, 0.0), 0.0, 1.5)),
-sphere(vec3(-5.7, 0.2, -2.7), 	  0.2, 	  material(material_lambertian, vec3(0.8, 0.3, 0.3), 0.0, 0.0)),
-sphere(vec3(-3.6, 0.2, -4.4), 	  0.2, 	  material(material_lambertian, vec3(0.9, 0.3, 0.2), 0.0, 0.0)),
-sphere(vec3(0.8, 0.2, 2.3), 	  0.2, 	  material(material_lambertian, vec3(0.2, 0.0, 0.5), 0.0, 0.0)),
-sphere(vec3(3.8, 0.2, 4.2), 	  0.2, 	  material(material_lambertian, vec3(0.4, 0.3, 0.7), 0.0, 0.0)),
-sphere(vec3(-0.1, 0.2, -1.9), 	  0.2, 	  material(material_lambertian, vec3(0.4, 0.0, 0.4), 0.0, 0.0)),
-sphere(vec3(-2.5, 0.2, 5.4), 	  0.2, 	  material(material_metal, 	    vec3(0.3, 0.7, 0.9), 0.3, 0.0)),
-sphere(vec3(-3.9, 0.2, -0.3), 	  0.2, 	  material(material_lambertian, vec3(0.9, 0.8, 0.5), 0.0, 0.0)),
-sphere(vec3(-6.0, 0.2, 4.0), 	  0.2, 	  material(material_lambertian, vec3(0.9, 0.9, 0.5), 0.0, 0.0)),
-sphere(vec3(4.4, 0.2, -0.5), 	  0.2, 	  material(material_lambertian, vec3(0.5, 0.4, 0.8), 0.0, 0.0)),
-sphere(vec3(3.4, 0.2, 5.3), 	  0.2, 	  material(material_lambertian, vec3(0.1, 0.6, 0.2), 0.0, 0.0)),
-sphere(vec3(4.6, 0.2, -3.8), 	  0.2, 	  material(material_lambertian, vec3(0.2, 0.2, 0.2), 0.0, 0.0)),
-sphere(vec3(0.7, 0.2, -2.5), 	  0.2, 	  material(material_metal, 	    vec3(0.0, 0.2, 0.1), 0.0, 0.0)),
-sphere(vec3(2.4, 0.2, -4.3), 	  0.2, 	  material(material_lambertian, vec3(0.8, 0.9, 0.0), 0.0, 0.0)),
-sphere(vec3(4.4, 0.2, 4.9), 	  0.2, 	  material(material_lambertian, vec3(0.8, 0.8, 0.0), 0.0, 0.0)),
-sphere(vec3(-4.7, 0.2, 4.6), 	  0.2, 	  material(material_lambertian, vec3(0.8, 0.8, 0.7), 0.0, 0.0)),
-sphere(vec3(4.2, 0.2, -3.5), 	  0.2, 	  material(material_lambertian, vec3(0.8, 0.8, 0.6), 0.0, 0.0)),
-sphere(vec3(-5.2, 0.2, 0.5), 	  0.2, 	  material(material_lambertian, vec3(0.2, 0.7, 0.9), 0.0, 0.0)),
-sphere(vec3(5.7, 0.2, -0.8), 	  0.2, 	  material(material_lambertian, vec3(0.3, 0.0, 0.7), 0.0, 0.0))
-);
+// Reads sphere i from the scene texture buffer
+sphere fetch_sphere(int i) {
+	vec4 geometry = texelFetch(u_spheres, i * SPHERE_TEXELS);
+	vec4 surface = texelFetch(u_spheres, i * SPHERE_TEXELS + 1);
+	vec4 optics = texelFetch(u_spheres, i * SPHERE_TEXELS + 2);
+	return sphere(geometry.xyz, geometry.w, material(int(surface.w), surface.rgb, optics.x, optics.y));
+}
 
 void hit_sphere(sphere sph, ray r, inout hit_record rec, inout bool hit_anything) {
 	float closest_so_far = rec.t;
@@ -143,42 +139,61 @@ void hit_sphere(sphere sph, ray r, inout hit_record rec, inout bool hit_anything
 	rec = hit_record(p, (p - sph.center) / sph.radius, root, sph.material);
 }
 
+// Whether the ray passes through the box somewhere in [0.001, max_t]
+bool hit_box(vec3 box_min, vec3 box_max, ray r, vec3 inv_dir, float max_t) {
+	vec3 t0 = (box_min - r.origin) * inv_dir;
+	vec3 t1 = (box_max - r.origin) * inv_dir;
+	vec3 near = min(t0, t1);
+	vec3 far = max(t0, t1);
+	float enter = max(max(near.x, near.y), max(near.z, 0.001));
+	float exit = min(min(far.x, far.y), min(far.z, max_t));
+	return enter <= exit;
+}
+
 bool hit(ray r, out hit_record rec) {
 	bool hit = false;
 	// Set initial hit distance to max
 	rec = hit_record(vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, 0.0), 9999.0, material(material_lambertian, vec3(0.0, 0.0, 0.0), 0.0, 0.0));
+	if (u_sphereCount == 0) {
+		return false;
+	}
 
-	// unrolling this loop gave 4x perf boost...
-	hit_sphere(spheres[0],  r, rec, hit);
-	hit_sphere(spheres[1],  r, rec, hit);
-	hit_sphere(spheres[2],  r, rec, hit);
-	hit_sphere(spheres[3],  r, rec, hit);
-	hit_sphere(spheres[4],  r, rec, hit);
-	hit_sphere(spheres[5],  r, rec, hit);
-	hit_sphere(spheres[6],  r, rec, hit);
-	hit_sphere(spheres[7],  r, rec, hit);
-	hit_sphere(spheres[8],  r, rec, hit);
-	hit_sphere(spheres[9],  r, rec, hit);
-	hit_sphere(spheres[10], r, rec, hit);
-	hit_sphere(spheres[11], r, rec, hit);
-	hit_sphere(spheres[12], r, rec, hit);
-	hit_sphere(spheres[13], r, rec, hit);
-	hit_sphere(spheres[14], r, rec, hit);
-	hit_sphere(spheres[15], r, rec, hit);
-	hit_sphere(spheres[16], r, rec, hit);
-	hit_sphere(spheres[17], r, rec, hit);
-	hit_sphere(spheres[18], r, rec, hit);
-	hit_sphere(spheres[19], r, rec, hit);
-	hit_sphere(spheres[21], r, rec, hit);
-	hit_sphere(spheres[22], r, rec, hit);
-	hit_sphere(spheres[23], r, rec, hit);
+	// Walk the hierarchy, visiting the nearer child first along each node's split axis and
+	// keeping the farther one on a stack no deeper than the tree
+	vec3 inv_dir = 1.0 / r.dir;
+	int stack[BVH_STACK_SIZE];
+	int top = 0;
+	int node = 0;
+	while (true) {
+		vec4 lower = texelFetch(u_bvh, node * BVH_TEXELS);
+		vec4 upper = texelFetch(u_bvh, node * BVH_TEXELS + 1);
+		if (hit_box(lower.xyz, upper.xyz, r, inv_dir, rec.t)) {
+			int count = int(upper.w);
+			if (count > 0) {
+				int first = int(lower.w);
+				for (int i = first; i < first + count; i++) {
+					hit_sphere(fetch_sphere(i), r, rec, hit);
+				}
+			} else {
+				int axis = -count - 1;
+				bool backwards = r.dir[axis] < 0.0;
+				stack[top++] = backwards ? node + 1 : int(lower.w);
+				node = backwards ? int(lower.w) : node + 1;
+				continue;
+			}
+		}
+		if (top == 0) {
+			break;
+		}
+		node = stack[--top];
+	}
 
 	return hit;
 }
 
 bool near_zero(vec3 p) {
 	float s = 1e-8;
-	return p.x < s && p.y < s && p.z < s;
+	return abs(p.x) < s && abs(p.y) < s && abs(p.z) < s;
 }
 
 float reflectance(float cosine, float ref_idx) {
@@ -188,25 +203,28 @@ float reflectance(float cosine, float ref_idx) {
 	return r0 + (1.0 - r0) * pow((1.0 - cosine), 5.);
 }
 
-void scatter(hit_record rec, ray r, vec2 seed, inout vec3 attenuation, inout ray scattered) {
+// Returns false when the surface absorbs the ray, which leaves attenuation and scattered unset
+bool scatter(hit_record rec, ray r, vec2 seed, inout vec3 attenuation, inout ray scattered) {
 	material m = rec.material;
 
 	if (m.type == material_lambertian) {
-		vec3 scatter_direction = normalize(rec.normal + random_unit_vector(seed));
+		vec3 scatter_direction = rec.normal + random_unit_vector(seed);
 
-		// catch degenerate scatter direction
+		// catch degenerate scatter direction, before normalizing it would turn it into NaN
 		if (near_zero(scatter_direction)) {
 			scatter_direction = rec.normal;
 		}
 
-		scattered = ray(rec.p, scatter_direction);
+		scattered = ray(rec.p, normalize(scatter_direction));
 		attenuation = m.albedo;
+		return true;
 	} else if (m.type == material_metal) {
 		vec3 reflected = reflect(r.dir, rec.normal);
 		ray scattered_ = ray(rec.p, normalize(reflected + m.metal_fuzz * random_in_unit_sphere(seed)));
 		if (dot(scattered_.dir, rec.normal) > 0.0) {
 			scattered = scattered_;
 			attenuation = m.albedo;
+			return true;
 		}
 	} else if (m.type == material_dielectric) {
 		bool front_face = dot(r.dir, rec.normal) < 0.;
@@ -228,7 +246,9 @@ void scatter(hit_record rec, ray r, vec2 seed, inout vec3 attenuation, inout ray
 
 		scattered = ray(rec.p, direction);
 		attenuation = vec3(1);
+		return true;
 	}
+	return false;
 }
 
 vec3 ray_color(in ray r, vec2 seed) {
@@ -239,7 +259,9 @@ vec3 ray_color(in ray r, vec2 seed) {
 		if (hit(r, rec)) {
 			ray scattered;
 			vec3 attenuation;
-			scatter(rec, r, seed * 999.0 + float(depth), attenuation, scattered);
+			if (!scatter(rec, r, seed * 999.0 + float(depth), attenuation, scattered)) {
+				return vec3(0.0, 0.0, 0.0); // absorbed; the unset ray must not be traced
+			}
 			r = scattered;
 			color *= attenuation;
 		} else {
@@ -297,5 +319,9 @@ void main()
 		);
 		color += ray_color(r, normalizedCoord);
 	}
-	fragColor = vec4(sqrt(color / SAMPLES_PER_PIXEL), 1.0);
+	// Blend into the running average: frame n weighs 1 / (n + 1), so every frame counts equally
+	// The average stays linear; display.glsl applies the gamma
+	vec3 history = texelFetch(u_history, ivec2(fragCoord), 0).rgb;
+	vec3 average = mix(history, color / SAMPLES_PER_PIXEL, 1.0 / float(u_frame + 1));
+	fragColor = vec4(average, 1.0);
 }
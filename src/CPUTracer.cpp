@@ -0,0 +1,421 @@
+#include "CPUTracer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#include "glm/geometric.hpp"
+#include "glm/common.hpp"
+
+// Everything in this namespace mirrors a definition of the same name in shaders/frag.glsl
+namespace {
+
+const float PI = 3.14159265359f;
+const float SAMPLES_PER_PIXEL = 10.0f;
+const int MAX_RAY_BOUNCES = 6;
+
+const int material_lambertian = MATERIAL_LAMBERTIAN;
+const int material_metal = MATERIAL_METAL;
+const int material_dielectric = MATERIAL_DIELECTRIC;
+
+struct ray {
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+struct material {
+    int type;
+    glm::vec3 albedo;
+    float metal_fuzz;
+    float dielectric_index_of_refraction;
+};
+
+struct hit_record {
+    glm::vec3 p;
+    glm::vec3 normal;
+    float t;
+    material mat;
+};
+
+// The scene as the tracer reads it: the hierarchy, the spheres in its leaf order, and their
+// centers and squared radii as separate arrays, so one ray is checked against a run of
+// spheres in a loop the compiler vectorizes
+struct scene_view {
+    const BVHNode* nodes;
+    int node_count;
+    const Sphere* spheres;
+    const float* cx;
+    const float* cy;
+    const float* cz;
+    const float* rr;
+};
+
+// Spheres solved per vectorized pass; the roots of one chunk fit on the stack
+const int HIT_CHUNK = 16;
+
+float fract(float x) {
+    return x - std::floor(x);
+}
+
+glm::vec3 fract(const glm::vec3& v) {
+    return glm::vec3(fract(v.x), fract(v.y), fract(v.z));
+}
+
+glm::vec2 fract(const glm::vec2& v) {
+    return glm::vec2(fract(v.x), fract(v.y));
+}
+
+float rand12(glm::vec2 p) {
+    glm::vec3 p3 = fract(glm::vec3(p.x, p.y, p.x) * 0.1031f);
+    p3 += glm::dot(p3, glm::vec3(p3.y, p3.z, p3.x) + 33.33f);
+    return fract((p3.x + p3.y) * p3.z);
+}
+
+glm::vec2 rand22(glm::vec2 p) {
+    glm::vec3 p3 = fract(glm::vec3(p.x, p.y, p.x) * glm::vec3(0.1031f, 0.1030f, 0.0973f));
+    p3 += glm::dot(p3, glm::vec3(p3.y, p3.z, p3.x) + 33.33f);
+    return fract((glm::vec2(p3.x, p3.x) + glm::vec2(p3.y, p3.z)) * glm::vec2(p3.z, p3.y));
+}
+
+glm::vec3 rand32(glm::vec2 p) {
+    glm::vec3 p3 = fract(glm::vec3(p.x, p.y, p.x) * glm::vec3(0.1031f, 0.1030f, 0.0973f));
+    p3 += glm::dot(p3, glm::vec3(p3.y, p3.x, p3.z) + 33.33f);
+    return fract((glm::vec3(p3.x, p3.x, p3.y) + glm::vec3(p3.y, p3.z, p3.z)) * glm::vec3(p3.z, p3.y, p3.x));
+}
+
+glm::vec3 random_in_unit_sphere(glm::vec2 p) {
+    glm::vec3 rand = rand32(p);
+    float phi = 2.0f * PI * rand.x;
+    float cosTheta = 2.0f * rand.y - 1.0f;
+    float u = rand.z;
+
+    float theta = std::acos(cosTheta);
+    float r = std::pow(u, 1.0f / 3.0f);
+
+    float x = r * std::sin(theta) * std::cos(phi);
+    float y = r * std::sin(theta) * std::sin(phi);
+    float z = r * std::cos(theta);
+
+    return glm::vec3(x, y, z);
+}
+
+glm::vec3 random_unit_vector(glm::vec2 p) {
+    glm::vec3 rand = rand32(p);
+    float phi = 2.0f * PI * rand.x;
+    float cosTheta = 2.0f * rand.y - 1.0f;
+    float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+    return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+glm::vec3 random_in_unit_disk(glm::vec2 p) {
+    glm::vec3 s = random_in_unit_sphere(p);
+    return glm::vec3(s.x, s.y, 0.0f);
+}
+
+// The shader's hit_leaf: hit_sphere for spheres [first, first + count). The quadratics of a
+// chunk of spheres are solved in one vectorized pass; the roots are then accepted in the
+// shader's order, which keeps its tie-breaking (a later sphere at the same distance wins).
+void hit_leaf(const scene_view& scene, const ray& r, int first, int count, float& closest_so_far, int& closest) {
+    float root0[HIT_CHUNK], root1[HIT_CHUNK];
+    bool crosses[HIT_CHUNK];
+    float a = glm::dot(r.dir, r.dir);
+    for (int start = first; start < first + count; start += HIT_CHUNK) {
+        int n = std::min(HIT_CHUNK, first + count - start);
+        const float* cx = scene.cx + start;
+        const float* cy = scene.cy + start;
+        const float* cz = scene.cz + start;
+        const float* rr = scene.rr + start;
+        for (int i = 0; i < n; i++) {
+            float ox = r.origin.x - cx[i];
+            float oy = r.origin.y - cy[i];
+            float oz = r.origin.z - cz[i];
+            float half_b = ox * r.dir.x + oy * r.dir.y + oz * r.dir.z;
+            float c = (ox * ox + oy * oy + oz * oz) - rr[i];
+            float discriminant = half_b * half_b - a * c;
+            crosses[i] = !(discriminant < 0.0f);
+            float sqrtd = std::sqrt(std::max(discriminant, 0.0f));
+            root0[i] = (-half_b - sqrtd) / a;
+            root1[i] = (-half_b + sqrtd) / a;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (!crosses[i]) {
+                continue;
+            }
+            float root = root0[i];
+            if (root < 0.001f || closest_so_far < root) {
+                root = root1[i];
+                if (root < 0.001f || closest_so_far < root) {
+                    continue;
+                }
+            }
+            closest_so_far = root;
+            closest = start + i;
+        }
+    }
+}
+
+// Whether the ray passes through the node's box somewhere in [0.001, max_t]
+bool hit_box(const BVHNode& node, glm::vec3 origin, glm::vec3 inv_dir, float max_t) {
+    glm::vec3 t0 = (node.boundsMin - origin) * inv_dir;
+    glm::vec3 t1 = (node.boundsMax - origin) * inv_dir;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.001f));
+    float exit = std::min(std::min(far.x, far.y), std::min(far.z, max_t));
+    return enter <= exit;
+}
+
+// The shader's hit(): a walk down the hierarchy with a stack of the farther children,
+// visiting the nearer child first along each node's split axis
+bool hit(const scene_view& scene, const ray& r, hit_record& rec) {
+    float closest_so_far = 9999.0f;
+    int closest = -1;
+    if (scene.node_count == 0) {
+        return false;
+    }
+    glm::vec3 inv_dir = 1.0f / r.dir;
+    int stack[BVH_MAX_DEPTH];
+    int top = 0;
+    int node = 0;
+    while (true) {
+        const BVHNode& n = scene.nodes[node];
+        if (hit_box(n, r.origin, inv_dir, closest_so_far)) {
+            if (n.countOrAxis > 0) {
+                hit_leaf(scene, r, n.secondChildOrFirstSphere, n.countOrAxis, closest_so_far, closest);
+            } else {
+                int axis = -n.countOrAxis - 1;
+                bool backwards = r.dir[axis] < 0.0f;
+                stack[top++] = backwards ? node + 1 : n.secondChildOrFirstSphere;
+                node = backwards ? n.secondChildOrFirstSphere : node + 1;
+                continue;
+            }
+        }
+        if (top == 0) {
+            break;
+        }
+        node = stack[--top];
+    }
+
+    if (closest >= 0) {
+        const Sphere& sph = scene.spheres[closest];
+        glm::vec3 p = r.origin + r.dir * closest_so_far;
+        material m = {sph.materialType, sph.albedo, sph.metalFuzz, sph.indexOfRefraction};
+        rec = hit_record{p, (p - sph.center) / sph.radius, closest_so_far, m};
+    }
+    return closest >= 0;
+}
+
+bool near_zero(glm::vec3 p) {
+    float s = 1e-8f;
+    return std::abs(p.x) < s && std::abs(p.y) < s && std::abs(p.z) < s;
+}
+
+float reflectance(float cosine, float ref_idx) {
+    float r0 = (1.0f - ref_idx) / (1.0f + ref_idx);
+    r0 = r0 * r0;
+    return r0 + (1.0f - r0) * std::pow((1.0f - cosine), 5.0f);
+}
+
+// Returns false when the surface absorbs the ray, which leaves attenuation and scattered unset
+bool scatter(const hit_record& rec, const ray& r, glm::vec2 seed, glm::vec3& attenuation, ray& scattered) {
+    const material& m = rec.mat;
+
+    if (m.type == material_lambertian) {
+        glm::vec3 scatter_direction = rec.normal + random_unit_vector(seed);
+        if (near_zero(scatter_direction)) {
+            scatter_direction = rec.normal;
+        }
+        scattered = ray{rec.p, glm::normalize(scatter_direction)};
+        attenuation = m.albedo;
+        return true;
+    } else if (m.type == material_metal) {
+        glm::vec3 reflected = glm::reflect(r.dir, rec.normal);
+        ray scattered_ = ray{rec.p, glm::normalize(reflected + m.metal_fuzz * random_in_unit_sphere(seed))};
+        if (glm::dot(scattered_.dir, rec.normal) > 0.0f) {
+            scattered = scattered_;
+            attenuation = m.albedo;
+            return true;
+        }
+    } else if (m.type == material_dielectric) {
+        bool front_face = glm::dot(r.dir, rec.normal) < 0.0f;
+        glm::vec3 adjusted_normal = front_face ? rec.normal : -rec.normal;
+        float ref = m.dielectric_index_of_refraction;
+        float refraction_ratio = front_face ? 1.0f / ref : ref;
+
+        float cos_theta = std::min(glm::dot(-r.dir, adjusted_normal), 1.0f);
+        float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+
+        bool cannot_refract = refraction_ratio * sin_theta > 1.0f;
+        glm::vec3 direction;
+        if (cannot_refract || reflectance(cos_theta, refraction_ratio) > rand12(seed)) {
+            direction = glm::reflect(r.dir, adjusted_normal);
+        } else {
+            direction = glm::refract(r.dir, adjusted_normal, refraction_ratio);
+        }
+        scattered = ray{rec.p, direction};
+        attenuation = glm::vec3(1.0f);
+        return true;
+    }
+    return false;
+}
+
+glm::vec3 ray_color(const scene_view& scene, ray r, glm::vec2 seed) {
+    glm::vec3 color(1.0f, 1.0f, 1.0f);
+    hit_record rec;
+    int depth;
+    for (depth = 0; depth < MAX_RAY_BOUNCES; depth++) {
+        if (hit(scene, r, rec)) {
+            ray scattered;
+            glm::vec3 attenuation;
+            if (!scatter(rec, r, seed * 999.0f + float(depth), attenuation, scattered)) {
+                return glm::vec3(0.0f, 0.0f, 0.0f); // absorbed; the unset ray must not be traced
+            }
+            r = scattered;
+            color *= attenuation;
+        } else {
+            float t = 0.5f * (r.dir.y + 1.0f);
+            color *= glm::mix(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.5f, 0.7f, 1.0f), t);
+            break;
+        }
+    }
+    if (depth == MAX_RAY_BOUNCES) {
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+    return color;
+}
+
+// The camera part of the shader's main(); it only depends on the uniforms
+struct frame_camera {
+    glm::vec3 origin, u, v, horizontal, vertical, lower_left_corner;
+    float lens_radius;
+
+    frame_camera(glm::vec2 u_resolution, float u_time, float u_camSpin) {
+        glm::vec3 lookfrom = glm::vec3(std::cos(u_time * u_camSpin) * 13.0f, 2.0f, std::sin(u_time * u_camSpin) * 10.0f);
+        glm::vec3 lookat = glm::vec3(0.0f, 0.0f, 0.0f);
+        glm::vec3 vup = glm::vec3(0.0f, 1.0f, 0.0f);
+        float vfov = 30.0f;
+        float aspect_ratio = u_resolution.x / u_resolution.y;
+        float aperture = 0.1f;
+        float focus_dist = 10.0f;
+
+        float theta = vfov * (PI / 180.0f);
+        float h = std::tan(theta / 2.0f);
+        float viewport_height = 2.0f * h;
+        float viewport_width = aspect_ratio * viewport_height;
+
+        glm::vec3 w = glm::normalize(lookfrom - lookat);
+        u = glm::normalize(glm::cross(vup, w));
+        v = glm::cross(w, u);
+
+        origin = lookfrom;
+        horizontal = focus_dist * viewport_width * u;
+        vertical = focus_dist * viewport_height * v;
+        lower_left_corner = origin - horizontal / 2.0f - vertical / 2.0f - focus_dist * w;
+
+        lens_radius = aperture / 2.0f;
+    }
+};
+
+// The sampling loop of the shader's main(), for the pixel whose center is fragCoord; returns the linear mean
+glm::vec3 shade(const scene_view& scene, const frame_camera& cam, glm::vec2 fragCoord, glm::vec2 u_resolution, float u_time) {
+    glm::vec3 color(0.0f);
+    for (float s = 0.0f; s < SAMPLES_PER_PIXEL; s++) {
+        glm::vec2 rand = rand22(fragCoord * 999.0f + s + u_time);
+
+        glm::vec2 normalizedCoord = (fragCoord + rand) / u_resolution;
+        glm::vec3 rd = cam.lens_radius * random_in_unit_disk(normalizedCoord * 999.0f + s + u_time);
+        glm::vec3 offset = cam.u * rd.x + cam.v * rd.y;
+        ray r = ray{
+            cam.origin + offset,
+            glm::normalize(cam.lower_left_corner + normalizedCoord.x * cam.horizontal + normalizedCoord.y * cam.vertical - cam.origin - offset)
+        };
+        color += ray_color(scene, r, normalizedCoord);
+    }
+    return color / SAMPLES_PER_PIXEL;
+}
+
+}
+
+// Constructor
+CPUTracer::CPUTracer(int width, int height, int threads) {
+    m_width = width;
+    m_height = height;
+    m_threads = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+    m_threads = std::max(1, m_threads);
+    m_pixels.resize(static_cast<size_t>(width) * height);
+    setScene(SphereScene::defaultScene());
+}
+
+// Replaces the spheres to trace
+void CPUTracer::setScene(const SphereScene& scene) {
+    m_bvh = std::make_shared<SphereBVH>(scene);
+    const std::vector<Sphere>& spheres = m_bvh->getScene().getSpheres();
+    size_t count = spheres.size();
+    m_sphereArrays.assign(4 * count, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        m_sphereArrays[i] = spheres[i].center.x;
+        m_sphereArrays[count + i] = spheres[i].center.y;
+        m_sphereArrays[2 * count + i] = spheres[i].center.z;
+        m_sphereArrays[3 * count + i] = spheres[i].radius * spheres[i].radius;
+    }
+}
+
+// Renders one frame for the given u_time, u_camSpin and u_frame uniforms
+void CPUTracer::render(float time, float camSpin, int frame) {
+    std::atomic<int> nextRow(0);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < m_threads; t++) {
+        workers.emplace_back(&CPUTracer::renderRows, this, std::ref(nextRow), time, camSpin, frame);
+    }
+    renderRows(nextRow, time, camSpin, frame); // the calling thread works too
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Renders rows of the frame until none are left
+void CPUTracer::renderRows(std::atomic<int>& nextRow, float time, float camSpin, int frame) {
+    glm::vec2 resolution(static_cast<float>(m_width), static_cast<float>(m_height));
+    frame_camera cam(resolution, time, camSpin);
+    float weight = 1.0f / float(frame + 1);
+    const std::vector<Sphere>& spheres = m_bvh->getScene().getSpheres();
+    size_t count = spheres.size();
+    const float* arrays = m_sphereArrays.data();
+    scene_view scene = {
+        m_bvh->getNodes().data(), static_cast<int>(m_bvh->getNodes().size()),
+        spheres.data(), arrays, arrays + count, arrays + 2 * count, arrays + 3 * count
+    };
+    for (int y = nextRow++; y < m_height; y = nextRow++) {
+        for (int x = 0; x < m_width; x++) {
+            glm::vec2 fragCoord(x + 0.5f, y + 0.5f); // gl_FragCoord is the pixel center
+            glm::vec3& average = m_pixels[static_cast<size_t>(y) * m_width + x];
+            average = glm::mix(average, shade(scene, cam, fragCoord, resolution, time), weight);
+        }
+    }
+}
+
+// Returns the displayed color of a pixel before quantization, as shaders/display.glsl computes it
+glm::vec3 CPUTracer::getPixel(int x, int y) const {
+    return glm::sqrt(m_pixels[static_cast<size_t>(y) * m_width + x]);
+}
+
+// Writes the frame as a binary PPM, quantized the way an 8-bit color buffer stores it
+// OpenGL converts to normalized integers by clamping and rounding to nearest; rows are flipped because PPM starts at the top
+bool CPUTracer::writePPM(const std::string& path) const {
+    std::vector<unsigned char> bytes;
+    bytes.reserve(static_cast<size_t>(m_width) * m_height * 3);
+    for (int y = m_height - 1; y >= 0; y--) {
+        for (int x = 0; x < m_width; x++) {
+            glm::vec3 c = getPixel(x, y);
+            for (int i = 0; i < 3; i++) {
+                float v = std::min(std::max(c[i], 0.0f), 1.0f);
+                bytes.push_back(static_cast<unsigned char>(std::floor(v * 255.0f + 0.5f)));
+            }
+        }
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << m_width << ' ' << m_height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(out);
+}
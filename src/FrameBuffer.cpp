@@ -1,12 +1,40 @@
 #include "FrameBuffer.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+// The files the shaders are built from
+static const std::string VERTEX_SHADER_PATH = "./shaders/vert.glsl";
+static const std::string TRACE_SHADER_PATH = "./shaders/frag.glsl";
+static const std::string DISPLAY_SHADER_PATH = "./shaders/display.glsl";
+
 // Constructor
 FrameBuffer::FrameBuffer() {
+    // Programs linked by an earlier run are loaded from disk instead of being compiled again
+    m_programCache = std::make_shared<ProgramCache>();
     m_shader = std::make_shared<Shader>(); // initialize the shader
     // Set up the shaders for the Frame Buffer Object
-    std::string fboVertexShader = m_shader->loadShader("./shaders/vert.glsl");
-    std::string fboFragmentShader = m_shader->loadShader("./shaders/frag.glsl");
-    m_shader->createShader(fboVertexShader, fboFragmentShader); // create our shaders
+    std::string fboVertexShader = m_shader->loadShader(VERTEX_SHADER_PATH);
+    std::string fboFragmentShader = m_shader->loadShader(TRACE_SHADER_PATH);
+    m_shader->createShader(fboVertexShader, fboFragmentShader, m_programCache.get()); // create our shaders
+    // The display shader shares the vertex shader, since it draws the same quad
+    m_displayShader = std::make_shared<Shader>();
+    std::string displayFragmentShader = m_displayShader->loadShader(DISPLAY_SHADER_PATH);
+    m_displayShader->createShader(fboVertexShader, displayFragmentShader, m_programCache.get());
+    m_current = 0;
+    m_frame = 0;
+    m_cameraAngle = 0.0f;
+    m_width = 0; // the sizes are known in 'create'
+    m_height = 0;
+    m_renderWidth = 0;
+    m_renderHeight = 0;
+    // The scene and its hierarchy live in buffers the shader reads as textures; they are empty until 'setScene'
+    glGenBuffers(2, m_sceneBufferIDs);
+    glGenTextures(2, m_sceneTextureIDs);
+    m_sphereCount = 0;
+    // The per-frame uniforms go up as one uniform block
+    m_frameUniforms = std::make_unique<UniformBuffer>(sizeof(FrameUniforms), 0);
+    setupShaderState();
     // Set up the quad to draw to
     // x and y of 0.0 put the quad in the top left corner
     // w and h of 1.0 stretch quad across entire screen
@@ -15,39 +43,145 @@ FrameBuffer::FrameBuffer() {
 
 // Destructor
 FrameBuffer::~FrameBuffer() {
-    glDeleteFramebuffers(1, &m_fboID);
+    m_reloader.reset(); // stop rebuilding shaders before anything goes away
+    glDeleteFramebuffers(2, m_fboIDs);
+    glDeleteTextures(2, m_accumulationIDs);
+    glDeleteTextures(2, m_sceneTextureIDs);
+    glDeleteBuffers(2, m_sceneBufferIDs);
     glDeleteVertexArrays(1, &m_quadVAO);
     glDeleteBuffers(1, &m_quadVBO);
 }
 
+// Sets the texture units of the samplers and connects the uniform block, which stay as they are until the shaders are rebuilt
+void FrameBuffer::setupShaderState() {
+    m_shader->bind();
+    m_shader->getUniform<int>("u_history").set(0); // the history texture is bound to slot 0
+    m_shader->getUniform<int>("u_spheres").set(1); // the scene to slot 1
+    m_shader->getUniform<int>("u_bvh").set(2); // and its hierarchy to slot 2
+    m_displayShader->bind();
+    m_displayShader->getUniform<int>("u_accumulation").set(0);
+    m_renderSizeUniform = m_displayShader->getUniform<glm::vec2>("u_renderSize");
+    Shader::unbind();
+    m_shader->bindUniformBlock("FrameUniforms", m_frameUniforms->getBindingPoint());
+    if (m_shader->getUniformBlockSize("FrameUniforms") != static_cast<GLint>(sizeof(FrameUniforms))) {
+        std::cerr << "The FrameUniforms block in frag.glsl does not match the FrameUniforms struct" << std::endl;
+    }
+}
+
+// Rebuilds the shaders in the background whenever their files change
+void FrameBuffer::watchShaders(SDL_Window* window) {
+    m_reloader = std::make_unique<ShaderReloader>(window, m_programCache);
+    if (!m_reloader->isRunning()) {
+        m_reloader.reset();
+        return;
+    }
+    m_reloader->watch(m_shader, VERTEX_SHADER_PATH, TRACE_SHADER_PATH);
+    m_reloader->watch(m_displayShader, VERTEX_SHADER_PATH, DISPLAY_SHADER_PATH);
+}
+
 // Creates the framebuffer
 // We create this in a second step because we need width and height information
 void FrameBuffer::create(int width, int height) {
-    glGenFramebuffers(1, &m_fboID); // generate a framebuffer
-    bind(); // select the buffer we have just generated
-    // Create a color attachment texture
-    glGenTextures(1, &m_colorBufferID);
-    glBindTexture(GL_TEXTURE_2D, m_colorBufferID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBufferID, 0);
+    m_width = width;
+    m_height = height;
+    m_renderWidth = width;
+    m_renderHeight = height;
+    glGenFramebuffers(2, m_fboIDs); // generate one framebuffer per accumulation texture
+    glGenTextures(2, m_accumulationIDs);
+    for (int i = 0; i < 2; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fboIDs[i]);
+        // Create a floating point color attachment texture, so the running average keeps its precision
+        glBindTexture(GL_TEXTURE_2D, m_accumulationIDs[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        // Linear filtering lets the display pass upscale a frame traced at a lower resolution; the trace pass fetches texels directly
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulationIDs[i], 0);
+        // New textures hold undefined values, and a NaN would survive being weighted by zero
+        const GLfloat black[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, black);
+    }
     unbind(); // deselect our buffer
 }
 
-// Selects our framebuffer
+// Traces the following frames into the lower left scale * scale of the textures
+// The textures keep their size, so a new scale costs no allocation, only the accumulated frames
+void FrameBuffer::setRenderScale(float scale) {
+    int renderWidth = std::max(1, static_cast<int>(std::lround(m_width * scale)));
+    int renderHeight = std::max(1, static_cast<int>(std::lround(m_height * scale)));
+    if (renderWidth != m_renderWidth || renderHeight != m_renderHeight) {
+        m_renderWidth = renderWidth;
+        m_renderHeight = renderHeight;
+        m_frame = 0; // the history was traced at another resolution
+    }
+}
+
+// Uploads the spheres the shader traces, with a hierarchy built over them
+// Returns false, and keeps the previous scene, if the scene is larger than the driver's texture buffers allow
+bool FrameBuffer::setScene(const SphereScene& scene) {
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    SphereBVH bvh(scene);
+    long long nodeTexels = static_cast<long long>(bvh.getNodes().size()) * BVH_TEXELS;
+    if (static_cast<long long>(scene.getSphereCount()) * SPHERE_TEXELS > maxTexels || nodeTexels > maxTexels) {
+        std::cerr << "A scene of " << scene.getSphereCount() << " spheres exceeds the texture buffer limit of "
+                  << maxTexels << " texels" << std::endl;
+        return false;
+    }
+    // Past this the float-encoded indices round, and the traversal silently jumps to the wrong nodes
+    if (bvh.getNodes().size() >= static_cast<size_t>(BVH_MAX_INDEX)) {
+        std::cerr << "A scene of " << scene.getSphereCount() << " spheres needs " << bvh.getNodes().size()
+                  << " hierarchy nodes, more than the " << BVH_MAX_INDEX << " the shader can index" << std::endl;
+        return false;
+    }
+    uploadTextureBuffer(0, bvh.getScene().pack()); // the spheres in the order the leaves index them
+    uploadTextureBuffer(1, bvh.pack());
+    m_sphereCount = scene.getSphereCount();
+    m_frame = 0; // the history shows the old scene
+    return true;
+}
+
+// Fills one of the scene's texture buffers with RGBA32F texels
+void FrameBuffer::uploadTextureBuffer(int index, const std::vector<float>& texels) {
+    glBindBuffer(GL_TEXTURE_BUFFER, m_sceneBufferIDs[index]);
+    glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(float), texels.data(), GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, m_sceneTextureIDs[index]);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_sceneBufferIDs[index]);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Selects the framebuffer this frame accumulates into
 void FrameBuffer::bind() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fboID);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboIDs[m_current]);
 }
 
 // Updates our framebuffer once per frame for any changes that may have occurred
-void FrameBuffer::update(const glm::mat4 &projectionMatrix, Camera* camera, int screenWidth, int screenHeight, float time) const {
-    glm::vec2 screenDimensions(screenWidth, screenHeight);
-    m_shader -> bind(); // select our framebuffer
-    // Set the uniforms in our current shader
-    m_shader -> setUniform1i("u_diffuseMap", 0); // note that we set the value to 0, because we have bound our texture to slot 0
-    m_shader -> setUniform1f("u_time", time);
-    m_shader -> setUniform2fv("u_resolution", &screenDimensions[0]);
-    m_shader -> setUniform1f("u_camSpin", camera -> getEyeYPosition());
+// The shader's camera position depends only on u_time * u_camSpin, so a change in that product is a camera motion
+// The resolution is the one set with 'setRenderScale'
+void FrameBuffer::update(const glm::mat4 &projectionMatrix, Camera* camera, float time) {
+    float camSpin = camera -> getEyeYPosition();
+    float cameraAngle = time * camSpin;
+    if (cameraAngle != m_cameraAngle) {
+        m_frame = 0; // the history shows another view, so start over
+        m_cameraAngle = cameraAngle;
+    }
+    // Swap in shaders rebuilt since the last frame; what they render may differ from the history
+    if (m_reloader && m_reloader->poll()) {
+        setupShaderState();
+        m_frame = 0;
+    }
+    // Set the uniforms in our current shader, all in one upload
+    FrameUniforms uniforms = {};
+    uniforms.resolution = glm::vec2(m_renderWidth, m_renderHeight);
+    uniforms.time = time;
+    uniforms.camSpin = camSpin;
+    uniforms.frame = m_frame;
+    uniforms.sphereCount = m_sphereCount;
+    m_frameUniforms -> update(uniforms);
 }
 
 // Done with our framebuffer
@@ -55,15 +189,39 @@ void FrameBuffer::unbind() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+// Traces this frame's samples and blends them with the history
+// The framebuffer and the trace shader need to be bound
+void FrameBuffer::drawAccumulation() const {
+    glViewport(0, 0, m_renderWidth, m_renderHeight);
+    glBindVertexArray(m_quadVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_accumulationIDs[1 - m_current]); // read last frame's average
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, m_sceneTextureIDs[0]);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, m_sceneTextureIDs[1]);
+    glActiveTexture(GL_TEXTURE0);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
 // Draws a quad to the screen
 // This is the actual rendering of our FBO to the screen
-// Typically, this would be called after 'update'
+// Typically, this would be called after 'drawAccumulation', with the display shader bound
 void FrameBuffer::drawFBO() const {
+    glViewport(0, 0, m_width, m_height);
+    m_renderSizeUniform.set(glm::vec2(m_renderWidth, m_renderHeight)); // the part of the texture to stretch over the screen
     glBindVertexArray(m_quadVAO);
-    glBindTexture(GL_TEXTURE_2D, m_colorBufferID); // use the color attachment texture as the texture of the quad plain
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_accumulationIDs[m_current]); // use this frame's average as the texture of the quad plain
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+// Makes this frame's average the history of the next one
+void FrameBuffer::swap() {
+    m_current = 1 - m_current;
+    m_frame++;
+}
+
 // Creates a quad that will be overlaid on top of the screen
 // x and y specify the position
 // w and h specify the width and the height
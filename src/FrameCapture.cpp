@@ -0,0 +1,314 @@
+#include "FrameCapture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// The CRC-32 of bytes, continuing from a previous one, as PNG chunks are checked with
+static unsigned int crc32(const unsigned char* bytes, size_t length, unsigned int crc = 0) {
+    static unsigned int table[256];
+    static bool filled = false;
+    if (!filled) {
+        for (unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        filled = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Appends a 32-bit big-endian number
+static void appendBigEndian(std::vector<unsigned char>& out, unsigned int value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+// Starts a PNG chunk of length bytes; endChunk appends its CRC once the data follows
+static size_t beginChunk(std::vector<unsigned char>& out, const char* type, size_t length) {
+    appendBigEndian(out, static_cast<unsigned int>(length));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    return start;
+}
+
+// Appends the CRC of the chunk begun at start
+static void endChunk(std::vector<unsigned char>& out, size_t start) {
+    appendBigEndian(out, crc32(&out[start], out.size() - start));
+}
+
+// The number of stored deflate blocks, of at most 65535 bytes each, that hold size bytes
+static size_t storedBlocks(size_t size) {
+    return std::max<size_t>(1, (size + 65534) / 65535);
+}
+
+// The size in bytes of a width * height PNG from encodePNG
+static size_t pngSize(int width, int height) {
+    size_t filtered = (static_cast<size_t>(width) * 3 + 1) * height;
+    size_t zlib = 2 + storedBlocks(filtered) * 5 + filtered + 4;
+    return 8 + (12 + 13) + (12 + zlib) + 12;
+}
+
+// Encodes filtered RGB24 rows from the top, each led by its filter type byte, as a PNG whose
+// image data is stored without compression
+// A stored deflate stream needs no zlib, and compressing would only slow the writer down
+// png is cleared first; with pngSize bytes reserved, encoding allocates nothing
+static void encodePNG(const std::vector<unsigned char>& filtered, int width, int height, std::vector<unsigned char>& png) {
+    png.clear();
+    const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    png.insert(png.end(), signature, signature + 8);
+    size_t chunk = beginChunk(png, "IHDR", 13);
+    appendBigEndian(png, static_cast<unsigned int>(width));
+    appendBigEndian(png, static_cast<unsigned int>(height));
+    const unsigned char format[] = {8, 2, 0, 0, 0}; // 8 bits per channel, RGB, no interlacing
+    png.insert(png.end(), format, format + 5);
+    endChunk(png, chunk);
+    // A zlib stream of stored blocks, closed with the Adler-32 of the data
+    chunk = beginChunk(png, "IDAT", 2 + storedBlocks(filtered.size()) * 5 + filtered.size() + 4);
+    png.push_back(0x78);
+    png.push_back(0x01);
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(65535, filtered.size() - offset);
+        bool last = offset + length == filtered.size();
+        png.push_back(last ? 1 : 0);
+        png.push_back(static_cast<unsigned char>(length));
+        png.push_back(static_cast<unsigned char>(length >> 8));
+        png.push_back(static_cast<unsigned char>(~length));
+        png.push_back(static_cast<unsigned char>(~length >> 8));
+        png.insert(png.end(), filtered.begin() + offset, filtered.begin() + offset + length);
+        offset += length;
+    } while (offset < filtered.size());
+    unsigned int a = 1;
+    unsigned int b = 0;
+    for (unsigned char c : filtered) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(png, (b << 16) | a);
+    endChunk(png, chunk);
+    endChunk(png, beginChunk(png, "IEND", 0));
+}
+
+// Constructor
+// Captures a width * height window whose frames are shown fps times per second
+FrameCapture::FrameCapture(int width, int height, double fps, CaptureFormat format, const std::string& path)
+    : m_width(width), m_height(height), m_format(format), m_path(path), m_full(QUEUED_FRAMES), m_free(QUEUED_FRAMES), m_done(false), m_failed(0) {
+    m_oldest = 0;
+    m_inFlight = 0;
+    m_captured = 0;
+    m_dropped = 0;
+    size_t frameBytes = static_cast<size_t>(width) * height * 4;
+    glGenBuffers(PBO_COUNT, m_pbos);
+    for (int i = 0; i < PBO_COUNT; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+        m_fences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    // All the frame memory is allocated here; afterwards the buffers only go around, and
+    // the writer converts and encodes into scratch space of its own sized for the format
+    for (int i = 0; i < QUEUED_FRAMES; i++) {
+        m_free.tryPush(CapturedFrame{std::vector<unsigned char>(frameBytes), 0});
+    }
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (m_format == CAPTURE_PNG) {
+        m_scratch.resize((static_cast<size_t>(width) * 3 + 1) * height);
+        m_encoded.reserve(pngSize(width, height));
+        m_fileName.reserve(m_path.size() + 16);
+    } else {
+        m_scratch.resize(pixelCount * 3);
+    }
+    if (m_format == CAPTURE_RAW || m_format == CAPTURE_Y4M) {
+        std::string file = m_path + (m_format == CAPTURE_RAW ? ".rgb" : ".y4m");
+        m_stream.open(file, std::ios::binary);
+        if (!m_stream.is_open()) {
+            std::cerr << "Could not open " << file << " for the capture" << std::endl;
+        }
+        if (m_format == CAPTURE_Y4M) {
+            // The frame rate is a ratio; thousandths are plenty for rates like 59.94
+            long long numerator = std::llround(fps * 1000.0);
+            m_stream << "YUV4MPEG2 W" << width << " H" << height << " F" << numerator << ":1000 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+        }
+        std::cout << "Capturing " << width << "x" << height << " at " << fps << " frames per second to " << file << std::endl;
+    } else {
+        std::cout << "Capturing " << width << "x" << height << " to " << m_path << "_000000.png and onwards" << std::endl;
+    }
+    m_writer = std::thread(&FrameCapture::run, this);
+}
+
+// Destructor
+// Waits for the frames in flight and the writer, then prints how many frames were captured and dropped
+FrameCapture::~FrameCapture() {
+    collect(true);
+    m_done.store(true, std::memory_order_release);
+    m_writer.join();
+    glDeleteBuffers(PBO_COUNT, m_pbos);
+    m_stream.close();
+    std::cout << "Captured " << m_captured << " frames, dropped " << m_dropped;
+    if (m_failed > 0) {
+        std::cout << ", failed to write " << m_failed;
+    }
+    std::cout << std::endl;
+}
+
+// Reads the back buffer back; call it after a frame has been drawn and before the window swaps
+void FrameCapture::capture() {
+    collect(false); // frees the ring slots of the readbacks that are done
+    if (m_inFlight == PBO_COUNT) {
+        m_dropped++; // every buffer is still being read back into; waiting would stall the frame
+        return;
+    }
+    int slot = (m_oldest + m_inFlight) % PBO_COUNT;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // With a pack buffer bound, the copy goes into it and the call returns without waiting
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_inFlight++;
+}
+
+// Hands the finished readbacks to the writer, oldest first; with wait, waits for all of them
+void FrameCapture::collect(bool wait) {
+    while (m_inFlight > 0) {
+        int slot = m_oldest;
+        GLenum status = wait ? glClientWaitSync(m_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) : glClientWaitSync(m_fences[slot], 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED && !wait) {
+            break; // the rest were issued later, so they are not done either
+        }
+        glDeleteSync(m_fences[slot]);
+        m_fences[slot] = 0;
+        CapturedFrame frame;
+        if ((status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) && m_free.tryPop(frame)) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+            void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(frame.pixels.size()), GL_MAP_READ_BIT);
+            if (pixels != nullptr) {
+                std::memcpy(frame.pixels.data(), pixels, frame.pixels.size());
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                frame.index = m_captured++;
+                m_full.tryPush(std::move(frame)); // there are as many slots as buffers, so it always fits
+            } else {
+                frame.index = -1; // the writer only hands the buffer back
+                m_full.tryPush(std::move(frame));
+                m_dropped++;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        } else {
+            m_dropped++; // the writer still holds every buffer
+        }
+        m_oldest = (m_oldest + 1) % PBO_COUNT;
+        m_inFlight--;
+    }
+}
+
+// Writes frames until the capture ends
+void FrameCapture::run() {
+    CapturedFrame frame;
+    while (true) {
+        // Read the flag first: every frame pushed before it was set is then still found below
+        bool done = m_done.load(std::memory_order_acquire);
+        if (m_full.tryPop(frame)) {
+            if (frame.index >= 0) {
+                write(frame);
+            }
+            m_free.tryPush(std::move(frame));
+            continue;
+        }
+        if (done) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Writes one frame in the capture's format
+void FrameCapture::write(const CapturedFrame& frame) {
+    // glReadPixels starts at the bottom row; every format here starts at the top
+    size_t pixelCount = static_cast<size_t>(m_width) * m_height;
+    auto pixel = [&](int x, int y) {
+        return &frame.pixels[(static_cast<size_t>(m_height - 1 - y) * m_width + x) * 4];
+    };
+    if (m_format == CAPTURE_Y4M) {
+        // Full range BT.601, one byte per sample in three planes
+        std::vector<unsigned char>& planes = m_scratch;
+        for (int y = 0; y < m_height; y++) {
+            for (int x = 0; x < m_width; x++) {
+                const unsigned char* p = pixel(x, y);
+                float r = p[0];
+                float g = p[1];
+                float b = p[2];
+                size_t i = static_cast<size_t>(y) * m_width + x;
+                planes[i] = static_cast<unsigned char>(std::lround(0.299f * r + 0.587f * g + 0.114f * b));
+                planes[pixelCount + i] = static_cast<unsigned char>(std::lround(std::min(255.0f, std::max(0.0f, 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b))));
+                planes[2 * pixelCount + i] = static_cast<unsigned char>(std::lround(std::min(255.0f, std::max(0.0f, 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b))));
+            }
+        }
+        m_stream << "FRAME\n";
+        m_stream.write(reinterpret_cast<const char*>(planes.data()), static_cast<std::streamsize>(planes.size()));
+        if (!m_stream) {
+            m_failed++;
+        }
+        return;
+    }
+    // Raw rows are packed RGB; PNG rows each start with filter type 0, none
+    size_t lead = (m_format == CAPTURE_PNG) ? 1 : 0;
+    size_t rowBytes = static_cast<size_t>(m_width) * 3 + lead;
+    for (int y = 0; y < m_height; y++) {
+        unsigned char* row = &m_scratch[y * rowBytes];
+        if (lead) {
+            row[0] = 0;
+        }
+        for (int x = 0; x < m_width; x++) {
+            std::memcpy(&row[lead + static_cast<size_t>(x) * 3], pixel(x, y), 3);
+        }
+    }
+    if (m_format == CAPTURE_RAW) {
+        m_stream.write(reinterpret_cast<const char*>(m_scratch.data()), static_cast<std::streamsize>(m_scratch.size()));
+        if (!m_stream) {
+            m_failed++;
+        }
+        return;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%06lld.png", frame.index);
+    encodePNG(m_scratch, m_width, m_height, m_encoded);
+    m_fileName.assign(m_path).append(name);
+    // Opening the file is the only allocation left, and it is the C library's
+    std::FILE* file = std::fopen(m_fileName.c_str(), "wb");
+    bool written = file != nullptr && std::fwrite(m_encoded.data(), 1, m_encoded.size(), file) == m_encoded.size();
+    if (file != nullptr && std::fclose(file) != 0) {
+        written = false;
+    }
+    if (!written) {
+        m_failed++;
+    }
+}
+
+// Reads "raw", "y4m" or "png"; returns false for anything else
+bool FrameCapture::parseFormat(const std::string& name, CaptureFormat& format) {
+    if (name == "raw") {
+        format = CAPTURE_RAW;
+    } else if (name == "y4m") {
+        format = CAPTURE_Y4M;
+    } else if (name == "png") {
+        format = CAPTURE_PNG;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+// Constructor
+// A target of 0 frames per second records frame times without waiting, for when vsync paces
+FramePacer::FramePacer(double targetFps) {
+    m_period = targetFps > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps)) : Clock::duration::zero();
+    m_lastFrame = Clock::now();
+    m_deadline = m_lastFrame + m_period;
+    m_frameTimes.reserve(1 << 16);
+}
+
+// Waits for the next frame's deadline, then records the time since the previous frame
+void FramePacer::endFrame() {
+    if (m_period > Clock::duration::zero()) {
+        // Sleep through most of the wait, then spin, since a sleep may overshoot by a millisecond or so
+        const auto spinMargin = std::chrono::milliseconds(2);
+        if (Clock::now() + spinMargin < m_deadline) {
+            std::this_thread::sleep_until(m_deadline - spinMargin);
+        }
+        while (Clock::now() < m_deadline) {
+            std::this_thread::yield();
+        }
+    }
+    Clock::time_point now = Clock::now();
+    m_frameTimes.push_back(std::chrono::duration<double, std::milli>(now - m_lastFrame).count());
+    m_lastFrame = now;
+    m_deadline += m_period;
+    if (now > m_deadline) {
+        m_deadline = now + m_period; // too far behind to catch up, start over from this frame
+    }
+}
+
+// Returns the p-th percentile (0 to 100) of the recorded frame times in milliseconds
+double FramePacer::percentile(double p) const {
+    if (m_frameTimes.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted = m_frameTimes;
+    size_t rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * sorted.size()));
+    size_t index = rank > 0 ? rank - 1 : 0; // the nearest-rank method
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+// Prints the number of frames and the mean, p50, p99 and worst frame times
+void FramePacer::report(std::ostream& out) const {
+    if (m_frameTimes.empty()) {
+        return;
+    }
+    double mean = std::accumulate(m_frameTimes.begin(), m_frameTimes.end(), 0.0) / m_frameTimes.size();
+    out << m_frameTimes.size() << " frames, frame time in ms: mean " << mean
+        << ", p50 " << percentile(50.0) << ", p99 " << percentile(99.0) << ", worst " << percentile(100.0) << std::endl;
+}
@@ -0,0 +1,157 @@
+#include "ProgramCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// The constants of ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// What a cache file starts with; the driver string and the binary follow it
+struct BinaryHeader {
+    std::uint32_t magic;
+    std::uint32_t format;
+    std::uint32_t driverLength;
+    std::uint32_t binaryLength;
+};
+static const std::uint32_t BINARY_MAGIC = 0x31425052; // "RPB1"
+
+// Constructor
+// Needs a current context; binaries go into the directory, which is created if needed
+ProgramCache::ProgramCache(const std::string& directory) : m_directory(directory) {
+    m_driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "\n"
+             + reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "\n"
+             + reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    m_getProgramBinary = nullptr;
+    m_programBinary = nullptr;
+    m_programParameteri = nullptr;
+    m_supported = false;
+    // The extension is core since OpenGL 4.1, which every driver offering it reports as well
+    if (SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+        m_getProgramBinary = reinterpret_cast<GetProgramBinaryFunction>(SDL_GL_GetProcAddress("glGetProgramBinary"));
+        m_programBinary = reinterpret_cast<ProgramBinaryFunction>(SDL_GL_GetProcAddress("glProgramBinary"));
+        m_programParameteri = reinterpret_cast<ProgramParameteriFunction>(SDL_GL_GetProcAddress("glProgramParameteri"));
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        m_supported = formats > 0 && m_getProgramBinary && m_programBinary && m_programParameteri;
+    }
+    if (!m_supported) {
+        SDL_Log("ProgramCache: the driver offers no program binaries, shaders are compiled every run");
+        return;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+        SDL_Log("ProgramCache: could not create %s, shaders are compiled every run", m_directory.c_str());
+        m_supported = false;
+    }
+}
+
+// Returns a linked program for the sources from the cache, or 0 on a miss
+GLuint ProgramCache::load(const std::string& vertexSource, const std::string& fragmentSource) const {
+    if (!m_supported) {
+        return 0;
+    }
+    std::string path = pathFor(vertexSource, fragmentSource);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    file.close();
+    const std::string bytes = contents.str();
+    BinaryHeader header;
+    if (bytes.size() < sizeof(header)) {
+        return 0;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    // Anything unexpected, including a driver string that only collides in the hash, is a miss
+    if (header.magic != BINARY_MAGIC || bytes.size() != sizeof(header) + header.driverLength + header.binaryLength
+        || bytes.compare(sizeof(header), header.driverLength, m_driver) != 0) {
+        return 0;
+    }
+    GLuint program = glCreateProgram();
+    m_programBinary(program, header.format, bytes.data() + sizeof(header) + header.driverLength, static_cast<GLsizei>(header.binaryLength));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        // Drivers may reject their own binaries, after an update that kept the version string for example
+        glDeleteProgram(program);
+        std::remove(path.c_str());
+        return 0;
+    }
+    return program;
+}
+
+// Asks the driver to keep the binary of a program that is about to be linked
+void ProgramCache::prepare(GLuint program) const {
+    if (m_supported) {
+        m_programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+// Saves a linked program's binary for the sources
+void ProgramCache::store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource) const {
+    if (!m_supported) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    m_getProgramBinary(program, length, &written, &format, binary.data());
+    BinaryHeader header = {BINARY_MAGIC, format, static_cast<std::uint32_t>(m_driver.size()), static_cast<std::uint32_t>(written)};
+    // Write to a file of our own and rename it, so a reader never sees half a binary
+    std::string path = pathFor(vertexSource, fragmentSource);
+    std::ostringstream temporary;
+    temporary << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    std::ofstream file(temporary.str(), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(m_driver.data(), static_cast<std::streamsize>(m_driver.size()));
+    file.write(binary.data(), written);
+    file.close();
+    std::error_code error;
+    if (!file) {
+        std::filesystem::remove(temporary.str(), error);
+        return;
+    }
+    std::filesystem::rename(temporary.str(), path, error);
+}
+
+// Returns the file a program of the sources is kept in
+std::string ProgramCache::pathFor(const std::string& vertexSource, const std::string& fragmentSource) const {
+    // The lengths separate the parts, so moving text from one source to the other changes the key
+    std::uint64_t key = hash(m_driver, 14695981039346656037ull);
+    key = hash(std::to_string(vertexSource.size()) + ":" + vertexSource, key);
+    key = hash(std::to_string(fragmentSource.size()) + ":" + fragmentSource, key);
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return m_directory + "/" + name + ".bin";
+}
+
+// Hashes bytes with 64-bit FNV-1a, continuing from a previous hash
+std::uint64_t ProgramCache::hash(const std::string& bytes, std::uint64_t seed) {
+    std::uint64_t result = seed;
+    for (unsigned char c : bytes) {
+        result = (result ^ c) * 1099511628211ull;
+    }
+    return result;
+}
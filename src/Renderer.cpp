@@ -8,12 +8,31 @@ Renderer::Renderer(int w, int h) {
     m_camera = new Camera(); // create one camera within the renderer
     m_frameBuffer = new FrameBuffer(); // create one framebuffer within the renderer
     m_frameBuffer -> create(w, h);
+    m_frameBuffer -> setScene(SphereScene::defaultScene());
+    m_resolutionScaler = new ResolutionScaler(0.0f); // full resolution until 'setTargetFrameTime'
 }
 
 // Destructor
 Renderer::~Renderer() {
     delete m_camera; // delete camera pointer
     delete m_frameBuffer; // delete framebuffer pointer
+    delete m_resolutionScaler;
+}
+
+// Replaces the spheres the ray tracer renders
+bool Renderer::setScene(const SphereScene& scene) {
+    return m_frameBuffer -> setScene(scene);
+}
+
+// Lowers the resolution of the ray tracer whenever it takes longer than targetMs on the GPU; 0 keeps the full resolution
+void Renderer::setTargetFrameTime(float targetMs) {
+    delete m_resolutionScaler;
+    m_resolutionScaler = new ResolutionScaler(targetMs);
+}
+
+// Rebuilds the shaders whenever their files change
+void Renderer::watchShaders(SDL_Window* window) {
+    m_frameBuffer -> watchShaders(window);
 }
 
 // Renders the scene
@@ -24,24 +43,28 @@ void Renderer::render(float time) {
     // Then the near and far clipping plane
     // Note I cannot see anything closer than 0.1f units from the screen
     m_projectionMatrix = glm::perspective(glm::radians(45.0f), ((float)m_screenWidth) / ((float)m_screenHeight), 0.1f, 512.0f);
-    m_frameBuffer -> update(m_projectionMatrix, m_camera, m_screenWidth, m_screenHeight, time); // update our framebuffer
+    m_frameBuffer -> setRenderScale(m_resolutionScaler -> getScale()); // trace at the resolution that fits the frame time
+    m_frameBuffer -> update(m_projectionMatrix, m_camera, time); // update our framebuffer
     m_frameBuffer -> bind(); // select our framebuffer
-    glViewport(0, 0, m_screenWidth, m_screenHeight);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // this is the background of the screen
-    // You should only see a single quad after rendering this, because we are only drawing one quad
-    // This is how we know things are working with our FBO
+    // Every pixel of the accumulation texture has to be written, so the trace pass is never drawn in wireframe
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    m_frameBuffer->m_shader->bind(); // trace new samples and blend them into the running average
+    m_resolutionScaler -> begin();
+    m_frameBuffer->drawAccumulation();
+    m_resolutionScaler -> end();
+    m_frameBuffer -> unbind(); // finish with our framebuffer
     const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
     if (currentKeyStates[SDL_SCANCODE_W]) { // press the 'w' key to toggle wireframe mode
         glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
     } else {
         glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
     }
-    m_frameBuffer -> unbind(); // finish with our framebuffer
     // Now draw a new scene
     // Clear everything away
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // clear the screen color, and typically I do this to something 'different' than our original as an indication that I am in an FBO.
     glClear(GL_COLOR_BUFFER_BIT); // we only have 'color' in our buffer that is stored
-    m_frameBuffer->m_shader->bind(); // use our new 'simple screen shader'
+    m_frameBuffer->m_displayShader->bind(); // use our 'simple screen shader'
     m_frameBuffer->drawFBO(); // overlay our 'quad' over the screen
-    m_frameBuffer->m_shader->unbind(); // unselect our shader and continue
+    m_frameBuffer->m_displayShader->unbind(); // unselect our shader and continue
+    m_frameBuffer->swap(); // the next frame blends into what we just drew
 }
@@ -0,0 +1,86 @@
+#include "ResolutionScaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Constructor
+// A target of 0 milliseconds keeps the full resolution
+ResolutionScaler::ResolutionScaler(float targetMs) {
+    glGenQueries(QUERY_COUNT, m_queries);
+    for (int i = 0; i < QUERY_COUNT; i++) {
+        m_queryScales[i] = 1.0f;
+        m_pending[i] = false;
+    }
+    m_next = 0;
+    m_timing = false;
+    m_targetMs = targetMs;
+    m_scale = 1.0f;
+    m_smoothedMs = -1.0f;
+    m_framesUnderBudget = 0;
+}
+
+// Destructor
+ResolutionScaler::~ResolutionScaler() {
+    glDeleteQueries(QUERY_COUNT, m_queries);
+}
+
+// Starts timing the trace pass
+void ResolutionScaler::begin() {
+    m_timing = false;
+    if (m_targetMs <= 0.0f || m_pending[m_next]) {
+        return; // every query is still in flight, so this frame goes untimed rather than waiting
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    m_timing = true;
+}
+
+// Stops timing the trace pass, and reads the timings that are ready to adjust the scale
+void ResolutionScaler::end() {
+    if (m_timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_queryScales[m_next] = m_scale;
+        m_pending[m_next] = true;
+        m_next = (m_next + 1) % QUERY_COUNT;
+    }
+    // Oldest first, stopping at the first query the GPU has not finished
+    for (int i = 0; i < QUERY_COUNT; i++) {
+        int query = (m_next + i) % QUERY_COUNT;
+        if (!m_pending[query]) {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(m_queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_queries[query], GL_QUERY_RESULT, &nanoseconds);
+        m_pending[query] = false;
+        if (m_queryScales[query] == m_scale) {
+            adjust(static_cast<float>(nanoseconds) * 1e-6f);
+        }
+    }
+}
+
+// Adjusts the scale to a new trace pass timing
+void ResolutionScaler::adjust(float milliseconds) {
+    m_smoothedMs = m_smoothedMs < 0.0f ? milliseconds : 0.8f * m_smoothedMs + 0.2f * milliseconds;
+    // Aim a little under the target, so the next spike does not push it over right away
+    float wanted = m_scale * std::sqrt(0.9f * m_targetMs / m_smoothedMs);
+    if (m_smoothedMs > m_targetMs) {
+        m_framesUnderBudget = 0;
+    } else if (m_scale < 1.0f && m_smoothedMs < 0.75f * m_targetMs) {
+        if (++m_framesUnderBudget < RAISE_AFTER_FRAMES) {
+            return;
+        }
+    } else {
+        m_framesUnderBudget = 0;
+        return;
+    }
+    float scale = std::clamp(std::floor(wanted * SCALE_STEPS) / SCALE_STEPS, MIN_RENDER_SCALE, 1.0f);
+    if (scale != m_scale) {
+        m_scale = scale;
+        m_smoothedMs = -1.0f; // the timings so far measured another resolution
+        m_framesUnderBudget = 0;
+    }
+}
@@ -58,9 +58,39 @@ SDLGraphicsProgram::~SDLGraphicsProgram() {
 }
 
 // Loops forever
-void SDLGraphicsProgram::loop() {
+// Input moves the camera in fixed steps of SIMULATION_STEP seconds, however fast frames are drawn
+void SDLGraphicsProgram::loop(const LoopOptions& options) {
     std::shared_ptr<Renderer> renderer = std::make_shared<Renderer>(m_width, m_height); // create a renderer
+    if (options.watchShaders) {
+        renderer -> watchShaders(m_window);
+    }
+    renderer -> setTargetFrameTime(options.targetFrameMs);
+    if (!options.scenePath.empty()) {
+        SphereScene scene;
+        if (SphereScene::fromFile(options.scenePath, scene)) {
+            renderer -> setScene(scene); // keeps the default scene if this one is too large
+        }
+    }
     renderer -> getCamera() -> setCameraEyePosition(0.0f, 0.0f, 10.0f); // set a default position for our camera
+    // Let the display pace us if it can: adaptive vsync first, then plain vsync, else our own pacer
+    bool vsync = false;
+    if (options.vsync) {
+        vsync = SDL_GL_SetSwapInterval(-1) == 0 || SDL_GL_SetSwapInterval(1) == 0;
+    }
+    if (!vsync) {
+        SDL_GL_SetSwapInterval(0);
+    }
+    FramePacer pacer(vsync ? 0.0 : options.targetFps);
+    std::unique_ptr<FrameCapture> capture;
+    if (!options.capturePath.empty()) {
+        // The rate a recording plays back at is the one the frames were shown at
+        double fps = options.targetFps > 0.0 ? options.targetFps : 60.0;
+        SDL_DisplayMode mode;
+        if (vsync && SDL_GetWindowDisplayMode(m_window, &mode) == 0 && mode.refresh_rate > 0) {
+            fps = mode.refresh_rate;
+        }
+        capture = std::make_unique<FrameCapture>(m_width, m_height, fps, options.captureFormat, options.capturePath);
+    }
     // Main loop flag
     bool quit = false; // if this is quit = 'true', then the program terminates
     SDL_Event e; // event handler that handles various events in SDL that are related to input and output
@@ -68,16 +98,16 @@ void SDLGraphicsProgram::loop() {
     float cameraSpeed = 5.0f; // set the camera speed for how fast we move
     SDL_WarpMouseInWindow(m_window, m_width / 2, m_height / 2); // center our mouse
     const Uint8* keyboardState = SDL_GetKeyboardState(NULL); // get a pointer to the keyboard state
-    // Set the frame per seconds
-    const int fps = 55;
-    const int frameDelay = 1000 / fps;
-    auto startTime = std::chrono::high_resolution_clock::now();
+    auto startTime = FramePacer::Clock::now();
+    auto previousTime = startTime;
+    double unsimulated = 0.0; // seconds that passed but have not been simulated yet
     // while application is running
     while (!quit) {
-        auto startTick = SDL_GetTicks();
         // Get the elapsed time in seconds
-        auto currentTime = std::chrono::high_resolution_clock::now();
+        auto currentTime = FramePacer::Clock::now();
         std::chrono::duration<double> elapsedTime = currentTime - startTime;
+        unsimulated += std::chrono::duration<double>(currentTime - previousTime).count();
+        previousTime = currentTime;
         // Handle events on queue
         while(SDL_PollEvent(&e) != 0) {
             // User posts an event to quit
@@ -92,34 +122,72 @@ void SDLGraphicsProgram::loop() {
 //                renderer -> getCamera() -> mouseLook(mouseX, mouseY);
 //            }
         } // End SDL_PollEvent loop.
-        // Move leftward or rightward
-        if (keyboardState[SDL_SCANCODE_LEFT]) {
-            renderer -> getCamera() -> moveLeft(cameraSpeed);
-        } else if (keyboardState[SDL_SCANCODE_RIGHT]) {
-            renderer -> getCamera() -> moveRight(cameraSpeed);
-        }
-        // Move forward or backward
-        if (keyboardState[SDL_SCANCODE_UP]) {
-//            renderer -> getCamera() -> moveForward(cameraSpeed);
-        } else if (keyboardState[SDL_SCANCODE_DOWN]) {
-            renderer -> getCamera() -> moveBackward(cameraSpeed);
+        // After a long stall, such as a dragged window, drop the backlog rather than simulating it all at once
+        unsimulated = std::min(unsimulated, MAX_SIMULATION_BACKLOG);
+        while (unsimulated >= SIMULATION_STEP) {
+            float step = cameraSpeed * static_cast<float>(SIMULATION_STEP);
+            // Move leftward or rightward
+            if (keyboardState[SDL_SCANCODE_LEFT]) {
+                renderer -> getCamera() -> moveLeft(step);
+            } else if (keyboardState[SDL_SCANCODE_RIGHT]) {
+                renderer -> getCamera() -> moveRight(step);
+            }
+            // Move forward or backward
+            if (keyboardState[SDL_SCANCODE_UP]) {
+//                renderer -> getCamera() -> moveForward(step);
+            } else if (keyboardState[SDL_SCANCODE_DOWN]) {
+                renderer -> getCamera() -> moveBackward(step);
+            }
+            // Move upward or downward
+//            if (keyboardState[SDL_SCANCODE_LSHIFT] || keyboardState[SDL_SCANCODE_RSHIFT]) {
+//                renderer -> getCamera() -> moveUp(step);
+//            } else if (keyboardState[SDL_SCANCODE_LCTRL] || keyboardState[SDL_SCANCODE_RCTRL]) {
+//                renderer -> getCamera() -> moveDown(step);
+//            }
+            unsimulated -= SIMULATION_STEP;
         }
-        // Move upward or downward
-//        if (keyboardState[SDL_SCANCODE_LSHIFT] || keyboardState[SDL_SCANCODE_RSHIFT]) {
-//            renderer -> getCamera() -> moveUp(cameraSpeed);
-//        } else if (keyboardState[SDL_SCANCODE_LCTRL] || keyboardState[SDL_SCANCODE_RCTRL]) {
-//            renderer -> getCamera() -> moveDown(cameraSpeed);
-//        }
         renderer -> render(elapsedTime.count()); // render our ray tracer
-      	SDL_GL_SwapWindow(getSDLWindow()); // Update screen of our specified window
-        // Keep the frame per seconds constant
-        auto endTick = SDL_GetTicks();
-        int elapsedTick = endTick - startTick;
-        if (elapsedTick < frameDelay) {
-            SDL_Delay(frameDelay - elapsedTick);
+        if (capture) {
+            capture -> capture(); // the back buffer is only defined until the swap
         }
+      	SDL_GL_SwapWindow(getSDLWindow()); // Update screen of our specified window
+        pacer.endFrame(); // wait for the next frame, unless vsync already did
 	}
     SDL_StopTextInput(); // disable text input
+    capture.reset(); // finish the recording while the renderer's context is still around
+    pacer.report(std::cout);
+}
+
+// Times frames of random scenes with each of the given sphere counts and prints the results
+// Every frame is followed by glFinish, so the time covers the GPU's work and not just the command submission
+void SDLGraphicsProgram::benchmark(const std::vector<int>& sphereCounts, int frames) {
+    std::shared_ptr<Renderer> renderer = std::make_shared<Renderer>(m_width, m_height); // create a renderer
+    renderer -> getCamera() -> setCameraEyePosition(0.0f, 0.0f, 10.0f); // a still camera, as in the default loop
+    std::cout << "spheres, mean frame ms, min frame ms (" << m_width << "x" << m_height << ", " << frames << " frames each)" << std::endl;
+    float time = 0.0f;
+    for (int count : sphereCounts) {
+        if (!renderer -> setScene(SphereScene::randomScene(count))) {
+            continue;
+        }
+        // A couple of untimed frames let the driver finish uploading and compiling
+        for (int i = 0; i < 2; i++) {
+            renderer -> render(time);
+            glFinish();
+        }
+        double total = 0.0;
+        double fastest = 1e30;
+        for (int i = 0; i < frames; i++) {
+            SDL_PumpEvents(); // keep the window responsive
+            auto start = std::chrono::steady_clock::now();
+            renderer -> render(time);
+            glFinish();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            total += elapsed.count();
+            fastest = std::min(fastest, elapsed.count());
+            time += 1.0f / 55.0f; // the time step of the paced loop; a still camera ignores it apart from the noise pattern
+        }
+        std::cout << count << ", " << total / frames << ", " << fastest << std::endl;
+    }
 }
 
 // Queries OpenGL information
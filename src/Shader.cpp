@@ -1,7 +1,9 @@
 #include "Shader.hpp"
 
 // Constructor
-Shader::Shader() = default;
+Shader::Shader() {
+    m_shaderID = 0; // no program until 'createShader'
+}
 
 // Destructor
 Shader::~Shader() {
@@ -24,25 +26,41 @@ void Shader::log(const char* system, const char* message) {
 
 // Loads a shader
 std::string Shader::loadShader(const std::string &fileName) {
-    std::string result;
-    // Get every line of data
-    std::string line;
-    std::ifstream myFile(fileName.c_str());
-    if (myFile.is_open()) {
-        while (getline(myFile,line)) {
-                result += line + '\n';
-                // SDL_Log(line); // uncomment this if you want to see the shader code get printed out
-        }
-    } else {
+    // Read the whole file in one go; the sources are a single string for glShaderSource anyway
+    std::ifstream myFile(fileName.c_str(), std::ios::binary);
+    if (!myFile.is_open()) {
         log("loadShader", "file not found. Try an absolute file path to see if the file exists");
+        return std::string();
     }
+    std::ostringstream result;
+    result << myFile.rdbuf();
     myFile.close(); // close file
-    return result;
+    return result.str();
 }
 
 // Creates a shader from a loaded vertex and fragment shaders
-void Shader::createShader(const std::string &vertexShaderSource, const std::string &fragmentShaderSource) {
+// With a cache, a program linked by an earlier run is loaded instead of being compiled
+void Shader::createShader(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const ProgramCache* cache) {
+    GLuint program = buildProgram(vertexShaderSource, fragmentShaderSource, cache);
+    if (program == 0) {
+        log("createShader", "ERROR, shader did not link! Were there compile errors in the shader?");
+    }
+    adoptProgram(program);
+}
+
+// Compiles and links a program, or loads it from the cache; returns 0 if it does not link
+// Touches no Shader, so it can run on a background thread with a shared context current
+GLuint Shader::buildProgram(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const ProgramCache* cache) {
+    if (cache != nullptr) {
+        GLuint cached = cache->load(vertexShaderSource, fragmentShaderSource);
+        if (cached != 0) {
+            return cached;
+        }
+    }
     unsigned int program = glCreateProgram(); // create a new program
+    if (cache != nullptr) {
+        cache->prepare(program); // keep the binary around for 'store'
+    }
     // Compile our shaders
     unsigned int myVertexShader   = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
     unsigned int myFragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
@@ -59,9 +77,83 @@ void Shader::createShader(const std::string &vertexShaderSource, const std::stri
     glDeleteShader(myVertexShader);
     glDeleteShader(myFragmentShader);
     if (!checkLinkStatus(program)) {
-        log("createShader", "ERROR, shader did not link! Were there compile errors in the shader?");
+        glDeleteProgram(program);
+        return 0;
+    }
+    if (cache != nullptr) {
+        cache->store(program, vertexShaderSource, fragmentShaderSource);
     }
+    return program;
+}
+
+// Replaces the program with one linked elsewhere, deleting the old one
+void Shader::adoptProgram(GLuint program) {
+    glDeleteProgram(m_shaderID); // deleting program 0 is silently ignored
     m_shaderID = program;
+    reflect(); // look every uniform up now, so nothing has to be looked up per frame
+}
+
+// Records the active uniforms and uniform blocks of the linked program
+void Shader::reflect() {
+    m_uniforms.clear();
+    m_uniformBlocks.clear();
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(static_cast<size_t>(maxLength > 0 ? maxLength : 1), '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        UniformInfo info;
+        glGetActiveUniform(m_shaderID, static_cast<GLuint>(i), maxLength, &length, &info.size, &info.type, &name[0]);
+        std::string uniformName = name.substr(0, static_cast<size_t>(length));
+        info.location = glGetUniformLocation(m_shaderID, uniformName.c_str());
+        if (info.location < 0) {
+            continue; // a member of a uniform block; those are set through the block's buffer
+        }
+        m_uniforms[uniformName] = info;
+        // Arrays are reported as "name[0]", but may be set by their bare name
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos) {
+            m_uniforms[uniformName.substr(0, bracket)] = info;
+        }
+    }
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.assign(static_cast<size_t>(maxLength > 0 ? maxLength : 1), '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(m_shaderID, static_cast<GLuint>(i), maxLength, &length, &name[0]);
+        m_uniformBlocks[name.substr(0, static_cast<size_t>(length))] = static_cast<GLuint>(i);
+    }
+}
+
+// Returns the location of an active uniform, or -1
+GLint Shader::findUniform(const GLchar* name) const {
+    auto found = m_uniforms.find(name);
+    return found == m_uniforms.end() ? -1 : found->second.location;
+}
+
+// Connects the named uniform block to a binding point a UniformBuffer is bound to
+bool Shader::bindUniformBlock(const std::string& name, GLuint bindingPoint) const {
+    auto found = m_uniformBlocks.find(name);
+    if (found == m_uniformBlocks.end()) {
+        log("bindUniformBlock", ("no active uniform block " + name).c_str());
+        return false;
+    }
+    glUniformBlockBinding(m_shaderID, found->second, bindingPoint);
+    return true;
+}
+
+// Returns the size in bytes the driver reserves for the named uniform block, or 0 if there is none
+GLint Shader::getUniformBlockSize(const std::string& name) const {
+    auto found = m_uniformBlocks.find(name);
+    if (found == m_uniformBlocks.end()) {
+        return 0;
+    }
+    GLint size = 0;
+    glGetActiveUniformBlockiv(m_shaderID, found->second, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    return size;
 }
 
 // Compiles loaded shaders
@@ -123,7 +215,7 @@ bool Shader::checkLinkStatus(GLuint programID) {
 void Shader::setUniformMatrix4fv(const GLchar* name, const GLfloat* value) const{
     // Note that we are now 'looking' inside the shader for a particular
     // variable. This means the name has to exactly match!
-    GLint location = glGetUniformLocation(m_shaderID, name);
+    GLint location = findUniform(name);
     if (location >= 0) {
         // Now update this information through our uniforms.
         // glUniformMatrix4v means a 4x4 matrix of floats
@@ -136,7 +228,7 @@ void Shader::setUniformMatrix4fv(const GLchar* name, const GLfloat* value) const
 
 // Sets 2 float values in a vec2 in our uniform.
 void Shader::setUniform2fv(const GLchar* name, const GLfloat* value) const {
-    GLint location = glGetUniformLocation(m_shaderID, name);
+    GLint location = findUniform(name);
     if (location >= 0) {
         glUniform2fv(location, 1, value);
     } else {
@@ -147,13 +239,13 @@ void Shader::setUniform2fv(const GLchar* name, const GLfloat* value) const {
 
 // Sets 1 int value in our uniform
 void Shader::setUniform1i(const GLchar* name, int value) const{
-    GLint location = glGetUniformLocation(m_shaderID,name);
+    GLint location = findUniform(name);
     glUniform1i(location, value);
 }
 
 // Sets 1 float value in our uniform
 void Shader::setUniform1f(const GLchar* name, float value) const {
-    GLint location = glGetUniformLocation(m_shaderID,name);
+    GLint location = findUniform(name);
     if (location >= 0) {
         glUniform1f(location, value);
     } else {
@@ -161,3 +253,54 @@ void Shader::setUniform1f(const GLchar* name, float value) const {
         exit(EXIT_FAILURE);
     }
 }
+
+// Sets an int, or the texture unit of a sampler
+template <>
+void Uniform<int>::set(const int& value) const {
+    glUniform1i(m_location, value);
+}
+
+// Sets a float
+template <>
+void Uniform<float>::set(const float& value) const {
+    glUniform1f(m_location, value);
+}
+
+// Sets a vec2
+template <>
+void Uniform<glm::vec2>::set(const glm::vec2& value) const {
+    glUniform2fv(m_location, 1, &value[0]);
+}
+
+// Sets a mat4
+template <>
+void Uniform<glm::mat4>::set(const glm::mat4& value) const {
+    glUniformMatrix4fv(m_location, 1, GL_FALSE, &value[0][0]);
+}
+
+// Ints, bools and every sampler type are set with glUniform1i
+template <>
+bool Uniform<int>::accepts(GLenum type) {
+    switch (type) {
+        case GL_INT: case GL_BOOL:
+        case GL_SAMPLER_2D: case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <>
+bool Uniform<float>::accepts(GLenum type) {
+    return type == GL_FLOAT;
+}
+
+template <>
+bool Uniform<glm::vec2>::accepts(GLenum type) {
+    return type == GL_FLOAT_VEC2;
+}
+
+template <>
+bool Uniform<glm::mat4>::accepts(GLenum type) {
+    return type == GL_FLOAT_MAT4;
+}
@@ -0,0 +1,117 @@
+#include "ShaderReloader.hpp"
+
+#include <chrono>
+
+// Constructor
+// Creates the background context; the main context has to be current on this thread
+ShaderReloader::ShaderReloader(SDL_Window* window, std::shared_ptr<ProgramCache> cache) : m_window(window), m_cache(std::move(cache)), m_stop(false) {
+    // SDL makes a new context current, so the main one is put back right away
+    SDL_GLContext mainContext = SDL_GL_GetCurrentContext();
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    m_context = SDL_GL_CreateContext(m_window);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(m_window, mainContext);
+    if (m_context == NULL) {
+        SDL_Log("ShaderReloader: could not create a shared context, shaders will not be reloaded. SDL Error: %s", SDL_GetError());
+        return;
+    }
+    m_thread = std::thread(&ShaderReloader::run, this);
+}
+
+// Destructor
+// Stops the thread and drops programs that were never swapped in
+ShaderReloader::~ShaderReloader() {
+    m_stop = true;
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    for (const Built& built : m_built) {
+        glDeleteSync(built.fence);
+        glDeleteProgram(built.program);
+    }
+    m_built.clear();
+    m_watched.clear(); // the shaders may go now, while the main context is still current
+    if (m_context != NULL) {
+        SDL_GL_DeleteContext(m_context);
+    }
+}
+
+// Rebuilds the shader whenever one of its files changes
+void ShaderReloader::watch(std::shared_ptr<Shader> shader, const std::string& vertexPath, const std::string& fragmentPath) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_watched.push_back({std::move(shader), vertexPath, fragmentPath, modificationTime(vertexPath), modificationTime(fragmentPath)});
+}
+
+// Swaps in the programs that finished building; returns whether any shader changed
+// The caller has to set the uniforms and block bindings of the changed shaders up again
+bool ShaderReloader::poll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool changed = false;
+    for (auto it = m_built.begin(); it != m_built.end();) {
+        // A timeout of 0 only asks; a program still being linked waits for a later frame
+        GLenum status = glClientWaitSync(it->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ++it;
+            continue;
+        }
+        glDeleteSync(it->fence);
+        if (status == GL_WAIT_FAILED) {
+            glDeleteProgram(it->program);
+        } else {
+            it->shader->adoptProgram(it->program);
+            changed = true;
+        }
+        it = m_built.erase(it);
+    }
+    return changed;
+}
+
+// Polls the files and rebuilds what changed, until the reloader is destroyed
+void ShaderReloader::run() {
+    if (SDL_GL_MakeCurrent(m_window, m_context) != 0) {
+        SDL_Log("ShaderReloader: could not use the shared context, shaders will not be reloaded. SDL Error: %s", SDL_GetError());
+        return;
+    }
+    const auto interval = std::chrono::milliseconds(250);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_wake.wait_for(lock, interval, [this]() { return m_stop.load(); })) {
+        // Work on a copy, so the main thread's 'poll' never waits for a compile
+        std::vector<Watched> watched = m_watched;
+        lock.unlock();
+        for (size_t i = 0; i < watched.size() && !m_stop; i++) {
+            std::filesystem::file_time_type vertexTime = modificationTime(watched[i].vertexPath);
+            std::filesystem::file_time_type fragmentTime = modificationTime(watched[i].fragmentPath);
+            if (vertexTime == watched[i].vertexTime && fragmentTime == watched[i].fragmentTime) {
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50)); // editors may save in more than one write
+            GLuint program = Shader::buildProgram(Shader::loadShader(watched[i].vertexPath), Shader::loadShader(watched[i].fragmentPath), m_cache.get());
+            GLsync fence = 0;
+            if (program != 0) {
+                // The main context may only use the program once the driver is done with it
+                fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+            } else {
+                SDL_Log("ShaderReloader: %s did not build, the running version stays", watched[i].fragmentPath.c_str());
+            }
+            lock.lock();
+            m_watched[i].vertexTime = vertexTime;
+            m_watched[i].fragmentTime = fragmentTime;
+            if (program != 0) {
+                m_built.push_back({watched[i].shader, program, fence});
+            }
+            lock.unlock();
+        }
+        lock.lock();
+    }
+    lock.unlock();
+    SDL_GL_MakeCurrent(m_window, NULL);
+}
+
+// Returns the file's modification time, or the oldest time if it cannot be read
+std::filesystem::file_time_type ShaderReloader::modificationTime(const std::string& path) {
+    std::error_code error;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+    return error ? std::filesystem::file_time_type::min() : time;
+}
@@ -0,0 +1,161 @@
+#include "SphereBVH.hpp"
+
+#include <algorithm>
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+namespace {
+
+// Bins the sphere centers fall into along the split axis
+const int BVH_BINS = 16;
+// Nodes with this many spheres or fewer are always leaves
+const int BVH_LEAF_SIZE = 2;
+// Nodes with more spheres than this are split even when the heuristic prefers a leaf
+const int BVH_MAX_LEAF_SIZE = 8;
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const Bounds& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    // Half the surface area, which is all the heuristic needs
+    float area() const {
+        glm::vec3 d = max - min;
+        return (d.x < 0.0f) ? 0.0f : d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+// Padded a little, so rounding in the sphere test cannot find a hit just outside the box
+Bounds sphereBounds(const Sphere& s) {
+    float padded = s.radius + 1e-5f * (s.radius + glm::length(s.center)) + 1e-6f;
+    Bounds b;
+    b.grow(s.center - glm::vec3(padded));
+    b.grow(s.center + glm::vec3(padded));
+    return b;
+}
+
+}
+
+// Constructor
+// Builds the hierarchy with the surface area heuristic over binned sphere centers
+SphereBVH::SphereBVH(const SphereScene& scene) {
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    m_depth = 0;
+    m_order.resize(spheres.size());
+    for (size_t i = 0; i < spheres.size(); i++) {
+        m_order[i] = static_cast<int>(i);
+    }
+    if (!spheres.empty()) {
+        m_nodes.reserve(2 * spheres.size());
+        build(spheres, 0, static_cast<int>(spheres.size()), 0);
+    }
+    for (int index : m_order) {
+        m_scene.add(spheres[index]);
+    }
+}
+
+// Appends the node for spheres [first, first + count) of m_order, then its subtree
+void SphereBVH::build(const std::vector<Sphere>& spheres, int first, int count, int depth) {
+    Bounds bounds, centers;
+    for (int i = first; i < first + count; i++) {
+        bounds.grow(sphereBounds(spheres[m_order[i]]));
+        centers.grow(spheres[m_order[i]].center);
+    }
+    int nodeIndex = static_cast<int>(m_nodes.size());
+    m_nodes.push_back({bounds.min, first, bounds.max, count}); // a leaf unless a split is found below
+    m_depth = std::max(m_depth, depth);
+
+    glm::vec3 extent = centers.max - centers.min;
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+    if (count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH - 1 || extent[axis] <= 0.0f) {
+        return;
+    }
+
+    // Drop every sphere into a bin by its center, then sweep the bin boundaries for the cheapest split
+    auto binOf = [&](int sphere) {
+        float f = (spheres[sphere].center[axis] - centers.min[axis]) / extent[axis];
+        return std::min(BVH_BINS - 1, static_cast<int>(f * BVH_BINS));
+    };
+    Bounds binBounds[BVH_BINS];
+    int binCounts[BVH_BINS] = {};
+    for (int i = first; i < first + count; i++) {
+        int bin = binOf(m_order[i]);
+        binBounds[bin].grow(sphereBounds(spheres[m_order[i]]));
+        binCounts[bin]++;
+    }
+    float rightAreas[BVH_BINS];
+    int rightCounts[BVH_BINS];
+    Bounds right;
+    int rightCount = 0;
+    for (int b = BVH_BINS - 1; b > 0; b--) {
+        right.grow(binBounds[b]);
+        rightCount += binCounts[b];
+        rightAreas[b] = right.area();
+        rightCounts[b] = rightCount;
+    }
+    Bounds left;
+    int leftCount = 0;
+    int bestSplit = -1;
+    float bestCost = 1e30f;
+    for (int b = 1; b < BVH_BINS; b++) {
+        left.grow(binBounds[b - 1]);
+        leftCount += binCounts[b - 1];
+        if (leftCount == 0 || rightCounts[b] == 0) {
+            continue;
+        }
+        float cost = left.area() * leftCount + rightAreas[b] * rightCounts[b];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = b;
+        }
+    }
+
+    // A leaf costs one intersection per sphere; a split costs a box test plus its children's expected work
+    float leafCost = bounds.area() * count;
+    float splitCost = bounds.area() + bestCost;
+    if (count <= BVH_MAX_LEAF_SIZE && (bestSplit < 0 || splitCost >= leafCost)) {
+        return;
+    }
+
+    int* begin = m_order.data() + first;
+    int* middle;
+    if (bestSplit > 0) {
+        middle = std::partition(begin, begin + count, [&](int sphere) { return binOf(sphere) < bestSplit; });
+    } else { // every center fell into one bin; fall back to splitting at the median
+        middle = begin + count / 2;
+        std::nth_element(begin, middle, begin + count, [&](int a, int b) {
+            return spheres[a].center[axis] < spheres[b].center[axis];
+        });
+    }
+    int leftSize = static_cast<int>(middle - begin);
+
+    m_nodes[nodeIndex].countOrAxis = -(axis + 1);
+    build(spheres, first, leftSize, depth + 1);
+    m_nodes[nodeIndex].secondChildOrFirstSphere = static_cast<int>(m_nodes.size());
+    build(spheres, first + leftSize, count - leftSize, depth + 1);
+}
+
+// Packs the nodes into 4 * BVH_TEXELS floats each, ready for a GL_RGBA32F texture buffer
+std::vector<float> SphereBVH::pack() const {
+    std::vector<float> texels;
+    texels.reserve(m_nodes.size() * 4 * BVH_TEXELS);
+    for (const BVHNode& n : m_nodes) {
+        float node[4 * BVH_TEXELS] = {
+            n.boundsMin.x, n.boundsMin.y, n.boundsMin.z, static_cast<float>(n.secondChildOrFirstSphere),
+            n.boundsMax.x, n.boundsMax.y, n.boundsMax.z, static_cast<float>(n.countOrAxis)
+        };
+        texels.insert(texels.end(), node, node + 4 * BVH_TEXELS);
+    }
+    return texels;
+}
@@ -0,0 +1,126 @@
+#include "SphereScene.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "../oneWeekend/scene_file.h"
+
+// The files and the shader number the material types alike, so types are copied as they are
+static_assert(scene_lambertian == MATERIAL_LAMBERTIAN && scene_metal == MATERIAL_METAL && scene_dielectric == MATERIAL_DIELECTRIC,
+              "scene_file.h and SphereScene.hpp disagree on the material types");
+
+// Adds a sphere to the scene
+void SphereScene::add(const Sphere& sphere) {
+    m_spheres.push_back(sphere);
+}
+
+// Packs the spheres into 4 * SPHERE_TEXELS floats each, ready for a GL_RGBA32F texture buffer
+std::vector<float> SphereScene::pack() const {
+    std::vector<float> texels;
+    texels.reserve(m_spheres.size() * 4 * SPHERE_TEXELS);
+    for (const Sphere& s : m_spheres) {
+        float sphere[4 * SPHERE_TEXELS] = {
+            s.center.x, s.center.y, s.center.z, s.radius,
+            s.albedo.x, s.albedo.y, s.albedo.z, static_cast<float>(s.materialType),
+            s.metalFuzz, s.indexOfRefraction, 0.0f, 0.0f
+        };
+        texels.insert(texels.end(), sphere, sphere + 4 * SPHERE_TEXELS);
+    }
+    return texels;
+}
+
+// Returns the scene frag.glsl used to hard-code: a ground, three large spheres and 20 small ones
+// The shader's unrolled hit() never tested the sphere at (-4.7, 0.2, 4.6); it is part of the scene now
+SphereScene SphereScene::defaultScene() {
+    SphereScene scene;
+    scene.add({glm::vec3( 0.0f, -1000.0f, -1.0f), 1000.0f, MATERIAL_LAMBERTIAN, glm::vec3(0.5f, 0.5f, 0.5f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-4.0f, 1.0f, 2.0f),  1.0f, MATERIAL_DIELECTRIC, glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, 1.5f});
+    scene.add({glm::vec3( 0.0f, 1.0f, 0.0f),  1.0f, MATERIAL_METAL,      glm::vec3(0.7f, 0.6f, 0.5f), 0.0f, 0.0f});
+    scene.add({glm::vec3( 4.0f, 1.0f, 2.0f),  1.0f, MATERIAL_LAMBERTIAN, glm::vec3(0.7f, 0.3f, 0.3f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-6.0f, 0.2f, 2.8f),  0.2f, MATERIAL_DIELECTRIC, glm::vec3(0.0f, 0.0f, 0.2f), 0.0f, 1.5f});
+    scene.add({glm::vec3(1.6f, 0.2f, -0.9f),  0.2f, MATERIAL_DIELECTRIC, glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, 1.5f});
+    scene.add({glm::vec3(-5.7f, 0.2f, -2.7f), 0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.8f, 0.3f, 0.3f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-3.6f, 0.2f, -4.4f), 0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.9f, 0.3f, 0.2f), 0.0f, 0.0f});
+    scene.add({glm::vec3(0.8f, 0.2f, 2.3f),   0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.2f, 0.0f, 0.5f), 0.0f, 0.0f});
+    scene.add({glm::vec3(3.8f, 0.2f, 4.2f),   0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.4f, 0.3f, 0.7f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-0.1f, 0.2f, -1.9f), 0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.4f, 0.0f, 0.4f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-2.5f, 0.2f, 5.4f),  0.2f, MATERIAL_METAL,      glm::vec3(0.3f, 0.7f, 0.9f), 0.3f, 0.0f});
+    scene.add({glm::vec3(-3.9f, 0.2f, -0.3f), 0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.9f, 0.8f, 0.5f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-6.0f, 0.2f, 4.0f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.9f, 0.9f, 0.5f), 0.0f, 0.0f});
+    scene.add({glm::vec3(4.4f, 0.2f, -0.5f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.5f, 0.4f, 0.8f), 0.0f, 0.0f});
+    scene.add({glm::vec3(3.4f, 0.2f, 5.3f),   0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.1f, 0.6f, 0.2f), 0.0f, 0.0f});
+    scene.add({glm::vec3(4.6f, 0.2f, -3.8f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.2f, 0.2f, 0.2f), 0.0f, 0.0f});
+    scene.add({glm::vec3(0.7f, 0.2f, -2.5f),  0.2f, MATERIAL_METAL,      glm::vec3(0.0f, 0.2f, 0.1f), 0.0f, 0.0f});
+    scene.add({glm::vec3(2.4f, 0.2f, -4.3f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.8f, 0.9f, 0.0f), 0.0f, 0.0f});
+    scene.add({glm::vec3(4.4f, 0.2f, 4.9f),   0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.8f, 0.8f, 0.0f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-4.7f, 0.2f, 4.6f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.8f, 0.8f, 0.7f), 0.0f, 0.0f});
+    scene.add({glm::vec3(4.2f, 0.2f, -3.5f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.8f, 0.8f, 0.6f), 0.0f, 0.0f});
+    scene.add({glm::vec3(-5.2f, 0.2f, 0.5f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.2f, 0.7f, 0.9f), 0.0f, 0.0f});
+    scene.add({glm::vec3(5.7f, 0.2f, -0.8f),  0.2f, MATERIAL_LAMBERTIAN, glm::vec3(0.3f, 0.0f, 0.7f), 0.0f, 0.0f});
+    return scene;
+}
+
+// Returns the default scene's ground and large spheres plus small random ones, count spheres in all
+// Small spheres sit one per cell of a grid that grows with the count, skipping the cells under the large spheres
+SphereScene SphereScene::randomScene(int count, unsigned int seed) {
+    SphereScene base = defaultScene();
+    SphereScene scene;
+    for (int i = 0; i < 4 && i < count; i++) {
+        scene.add(base.getSpheres()[i]);
+    }
+    int small = count - scene.getSphereCount();
+    if (small <= 0) {
+        return scene;
+    }
+
+    // mt19937's output sequence is fixed by the standard, unlike the distributions', so scenes match across platforms
+    std::mt19937 generator(seed);
+    auto random = [&generator]() {
+        return static_cast<float>(generator() >> 8) * (1.0f / 16777216.0f);
+    };
+    const float cell = 1.0f; // with 0.6 of jitter, neighbors stay at least two radii apart
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(small) * 1.2f))) + 2; // room for the skipped cells; rows past the square just extend it
+    for (int i = 0; scene.getSphereCount() < count; i++) {
+        int gx = i % side;
+        int gz = i / side;
+        glm::vec3 center((gx - side / 2 + 0.6f * random()) * cell, 0.2f, (gz - side / 2 + 0.6f * random()) * cell);
+        bool underLarge = false;
+        for (int k = 1; k < 4; k++) {
+            glm::vec3 d = center - base.getSpheres()[k].center;
+            underLarge = underLarge || (d.x * d.x + d.z * d.z < 1.44f);
+        }
+        float choice = random();
+        glm::vec3 albedo(random(), random(), random());
+        if (underLarge) {
+            continue;
+        }
+        if (choice < 0.8f) {
+            scene.add({center, 0.2f, MATERIAL_LAMBERTIAN, albedo * albedo, 0.0f, 0.0f});
+        } else if (choice < 0.95f) {
+            scene.add({center, 0.2f, MATERIAL_METAL, 0.5f + 0.5f * albedo, 0.5f * random(), 0.0f});
+        } else {
+            scene.add({center, 0.2f, MATERIAL_DIELECTRIC, glm::vec3(0.0f), 0.0f, 1.5f});
+        }
+    }
+    return scene;
+}
+
+// Reads a text or binary scene file, as written for the CPU tracer
+// Returns false, and prints why, if the file cannot be read
+bool SphereScene::fromFile(const std::string& path, SphereScene& scene) {
+    scene_file file;
+    if (!file.load(path)) {
+        std::cerr << file.error() << std::endl;
+        return false;
+    }
+    scene.m_spheres.clear();
+    scene.m_spheres.reserve(file.sphere_count());
+    const scene_material* materials = file.materials();
+    for (size_t i = 0; i < file.sphere_count(); i++) {
+        const scene_sphere& s = file.spheres()[i];
+        const scene_material& m = materials[s.material];
+        scene.add({glm::vec3(s.center[0], s.center[1], s.center[2]), s.radius, static_cast<int>(m.type),
+                   glm::vec3(m.albedo[0], m.albedo[1], m.albedo[2]), m.fuzz, m.ir});
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#include "UniformBuffer.hpp"
+
+// Constructor
+// Allocates size bytes and binds them to the binding point
+UniformBuffer::UniformBuffer(size_t size, GLuint bindingPoint) {
+    m_size = size;
+    m_bindingPoint = bindingPoint;
+    glGenBuffers(1, &m_bufferID);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_DRAW); // rewritten every frame
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_bufferID);
+}
+
+// Destructor
+UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &m_bufferID);
+}
+
+// Replaces the first size bytes of the buffer in a single upload
+void UniformBuffer::update(const void* data, size_t size) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, static_cast<GLsizeiptr>(size < m_size ? size : m_size), data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
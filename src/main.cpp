@@ -1,14 +1,42 @@
 // Support Code written by Michael D. Shah
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "SDLGraphicsProgram.hpp"
 
 int main(int argc, char** argv) {
 	SDLGraphicsProgram mySDLGraphicsProgram(1280, 720); // create an instance of an object for an SDLGraphicsProgram
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) { // time frames for growing scenes instead of running interactively
+        int frames = argc > 2 ? std::atoi(argv[2]) : 60;
+        mySDLGraphicsProgram.benchmark({24, 64, 256, 1024, 4096, 16384}, frames > 0 ? frames : 60);
+        return 0;
+    }
+    LoopOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--watch") == 0) { // rebuild the shaders when their files change
+            options.watchShaders = true;
+        } else if (std::strcmp(argv[i], "--no-vsync") == 0) { // pace the frames ourselves
+            options.vsync = false;
+        } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) { // the rate to pace to without vsync, 0 for no limit
+            options.targetFps = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--target-ms") == 0 && i + 1 < argc) { // the ray tracer's frame budget, 0 for full resolution
+            options.targetFrameMs = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) { // render a scene file instead of the default scene
+            options.scenePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) { // record the frames to files starting with this path
+            options.capturePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc && FrameCapture::parseFormat(argv[i + 1], options.captureFormat)) {
+            i++;
+        } else {
+            std::cerr << "Usage: project [--watch] [--no-vsync] [--fps n] [--target-ms t] [--scene file] [--capture path [--capture-format raw|y4m|png]] | --bench [frames]" << std::endl;
+            return 1;
+        }
+    }
     std::cout << "Press the right arrow key to spin rightward" << std::endl;
     std::cout << "Press the left arrow key to spin leftward" << std::endl;
     std::cout << "Press the down arrow key to reset and stand still" << std::endl;
     std::cout << "Press the 'w' key to toggle wireframe mode" << std::endl;
     std::cout << "Press the 'esc' key or hit the 'x' on the top left corner to exit" << std::endl;
-	mySDLGraphicsProgram.loop(); // run our program forever
+	mySDLGraphicsProgram.loop(options); // run our program forever
 	return 0;
 }
@@ -0,0 +1,90 @@
+// Renders one frame of shaders/frag.glsl on the CPU and saves it, without SDL or OpenGL
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "CPUTracer.hpp"
+
+// Prints the command line options
+static void usage() {
+    std::cerr << "Usage: headless [--width w] [--height h] [--time t] [--spin s] [--threads n] [--frames n] [--spheres n] [--scene file] [-o image.ppm]" << std::endl;
+    std::cerr << "  --time and --spin are the shader's u_time and u_camSpin uniforms (defaults 0 and 0)" << std::endl;
+    std::cerr << "  --frames accumulates that many frames, 1/55 s apart, as the real-time path does (default 1)" << std::endl;
+    std::cerr << "  --spheres replaces the default scene with SphereScene::randomScene of that many spheres" << std::endl;
+    std::cerr << "  --scene replaces it with a text or binary scene file, see oneWeekend/scene_file.h" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int width = 1280; // the window size the SDL program opens
+    int height = 720;
+    int threads = 0;
+    int frames = 1;
+    int spheres = 0;
+    float time = 0.0f;
+    float camSpin = 0.0f;
+    std::string output = "headless.ppm";
+    std::string scenePath;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--width") == 0 && hasValue) {
+            width = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--height") == 0 && hasValue) {
+            height = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--time") == 0 && hasValue) {
+            time = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--spin") == 0 && hasValue) {
+            camSpin = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--spheres") == 0 && hasValue) {
+            spheres = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--scene") == 0 && hasValue) {
+            scenePath = argv[++i];
+        } else if (std::strcmp(argv[i], "-o") == 0 && hasValue) {
+            output = argv[++i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || frames <= 0) {
+        usage();
+        return 1;
+    }
+
+    CPUTracer tracer(width, height, threads);
+    if (!scenePath.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        SphereScene scene;
+        if (!SphereScene::fromFile(scenePath, scene)) {
+            return 1;
+        }
+        auto buildStart = std::chrono::steady_clock::now();
+        tracer.setScene(scene);
+        auto buildEnd = std::chrono::steady_clock::now();
+        std::cerr << "Loaded " << scene.getSphereCount() << " spheres in " << std::chrono::duration<double>(buildStart - loadStart).count()
+                  << " s and built their hierarchy in " << std::chrono::duration<double>(buildEnd - buildStart).count() << " s" << std::endl;
+    } else if (spheres > 0) {
+        tracer.setScene(SphereScene::randomScene(spheres));
+    }
+    auto start = std::chrono::steady_clock::now();
+    // A spinning camera moves every frame, which resets the accumulation, exactly as on the GPU
+    const float frameTime = 1.0f / 55.0f; // the frame rate SDLGraphicsProgram paces to
+    for (int frame = 0; frame < frames; frame++) {
+        tracer.render(time + frame * frameTime, camSpin, camSpin == 0.0f ? frame : 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!tracer.writePPM(output)) {
+        std::cerr << "Could not write " << output << std::endl;
+        return 1;
+    }
+    double megaPixels = static_cast<double>(width) * height / 1e6;
+    std::cerr << "Rendered " << frames << " frame(s) of " << width << "x" << height << " in " << seconds << " s ("
+              << megaPixels * frames / seconds << " Mpixel/s) to " << output << std::endl;
+    return 0;
+}